@@ -0,0 +1,41 @@
+#ifndef PATH_PLANNING_ALIGNED_ALLOCATOR_H
+#define PATH_PLANNING_ALIGNED_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Allocator for std::vector whose storage starts on an Alignment-byte boundary (e.g. a cache line).
+// Needed because std::allocator ignores over-alignment before C++17.
+template <class T, size_t Alignment>
+class aligned_allocator {
+public:
+    typedef T value_type;
+    template <class U> struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+    aligned_allocator() {}
+    template <class U> aligned_allocator(const aligned_allocator<U, Alignment> &) {}
+
+    T *allocate(size_t n) {
+        void *p = nullptr;
+        if(posix_memalign(&p, Alignment, n * sizeof(T)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T *p, size_t) {
+        free(p);
+    }
+};
+
+template <class T, class U, size_t Alignment>
+bool operator==(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) {
+    return true;
+}
+
+template <class T, class U, size_t Alignment>
+bool operator!=(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) {
+    return false;
+}
+
+#endif
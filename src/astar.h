@@ -2,11 +2,17 @@
 #define PATH_PLANNING_ASTAR_H
 
 #include <unordered_map>
-#include <set>
-#include <queue>
+#include <vector>
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <utility>
+#include <cstdint>
+#include "fork_join.h"
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
 
 using namespace std;
 
@@ -14,46 +20,266 @@ using namespace std;
     Performs A* search for "State" class that implements the following methods:
         State(const State &state);
         double scoreEstimate(); // Higher is better. Must be greater than or equal to true value.
-        vector<State> nextStates();
-        string key(); // Must be unique. Used to determine if we've seen this state before.
+        double scoreSoFar(); // Part of scoreEstimate() already earned. Only used by anytime search.
+        void forEachSuccessor(F &&f); // Calls f(const State &) for each state reachable in one step.
+        Key key(); // Must be unique. Used to determine if we've seen this state before.
+                   // Any type usable as an unordered_map key, e.g. string or a packed integer.
         string show();
         bool final(); // True if this state is candidate to be the end of a path.
-        bool operator<(const State& rhs) const; // Based on score_estimate, needed for priority_queue
+
+    scoreEstimate() is called exactly once per generated state and cached in its node.
+    With setThreads(), forEachSuccessor(), key(), scoreEstimate() and scoreSoFar() are called on
+    several states at once from different threads, so they must not modify anything shared.
+
+    By default this is plain A*. setAnytimeWeights() turns it into restarting weighted A*: each pass
+    orders the open list by scoreSoFar() + (scoreEstimate() - scoreSoFar()) / weight, which discounts
+    the optimistic remainder and so favours deeper states. A pass stops at its first final state or
+    when its open list runs out, and the next pass restarts from the initial state with the next
+    smaller weight, pruning anything that can't beat the incumbent. The last pass has weight 1 and
+    is plain A*, so the result is the same once finished() but a full-length path exists much sooner.
  */
 
 template <class State>
 class AStar {
 private:
-    unordered_map<string,State> closedStates;
-    unordered_map<string,string> keyToPrevKey;
-    unordered_map<string,int> keyToPathLength;
-    priority_queue<State> openStates; // priority queue allows lookup of largest element by default.
-    State bestState;
+    typedef decltype(declval<const State&>().key()) Key;
+    // Every generated state lives in one node of the arena, addressed by index.
+    // The parent index and path length are stored inline, so path() just follows parents.
+    struct Node {
+        State state;
+        uint32_t parent;
+        int pathLength;
+        double score; // scoreEstimate() of state.
+        Node(const State &state, uint32_t parent, int pathLength, double score)
+                : state(state), parent(parent), pathLength(pathLength), score(score) {}
+    };
+    static const uint32_t noParent = UINT32_MAX;
+    vector<Node> nodes;
+    unordered_map<Key,uint32_t> closedStates; // Key of each expanded state to its node.
+    vector<pair<double,uint32_t>> openStates; // Heap of (priority, node), largest priority on top.
+    uint32_t bestNode;
     double bestStateScore;
     int bestLength;
     bool bestStateFinal;
     bool _finished;
-    string initialKey;
+    size_t _expanded; // States expanded since reset().
+    double _stepSeconds; // Smoothed wall-clock cost of one calculateStep(), 0 until measured.
+    vector<double> _weights; // Anytime pass weights, decreasing and ending in 1. Empty for plain A*.
+    size_t _pass;
+    function<void(double,double)> _onImprovement;
+    double weight() const {
+        return _weights.empty() ? 1.0 : _weights[_pass];
+    }
+    // Successor generated by a parallel batch, with its scores already computed.
+    struct Expansion {
+        State state;
+        double score, soFar;
+        Expansion(const State &state, double score, double soFar) : state(state), score(score), soFar(soFar) {}
+    };
+    unique_ptr<ForkJoinPool> _pool; // Null in serial mode.
+    int _batchSize;
+    vector<uint32_t> _batch;
+    vector<vector<Expansion>> _expansions; // Successors of each batch entry, reused between batches.
+    void pushScored(const State &state, uint32_t parent, int pathLength, double score, double soFar) {
+        double priority = score;
+        if(weight() != 1.0) {
+            priority = soFar + (score - soFar) / weight();
+        }
+        openStates.push_back(make_pair(priority, uint32_t(nodes.size())));
+        push_heap(openStates.begin(), openStates.end());
+        nodes.push_back(Node(state, parent, pathLength, score));
+    }
+    void pushOpen(const State &state, uint32_t parent, int pathLength) {
+        pushScored(state, parent, pathLength, state.scoreEstimate(), weight() != 1.0 ? state.scoreSoFar() : 0.0);
+    }
+    enum Selection { Selected, Skipped, Stopped, Restarted };
+    // Pops the best open state into n, closes it and makes it the result if it is the best so far.
+    // Returns Selected if n should be expanded. Stopped means the search finished, or would have
+    // if mayFinish were true, in which case the state is left on the open list.
+    Selection select(bool mayFinish, uint32_t &n) {
+        if(openStates.empty()) {
+            if(!mayFinish) {
+                return Stopped;
+            }
+            // A weighted pass may have closed a key through a worse path first, so only an exhausted
+            // plain A* pass proves the best is optimal.
+            if(weight() != 1.0) {
+                nextPass();
+                return Restarted;
+            }
+            //cout << "Finished: no open states" << endl;
+            _finished = true;
+            return Stopped;
+        }
+        n = openStates.front().second;
+        double stateScore = nodes[n].score;
+        if(!mayFinish && bestStateFinal && stateScore < bestStateScore && weight() == 1.0) {
+            return Stopped;
+        }
+        pop_heap(openStates.begin(), openStates.end());
+        openStates.pop_back();
+        Key k = nodes[n].state.key();
+        if(closedStates.count(k) > 0) {
+            //cout << "Skip redundant key: " << nodes[n].state.show() << endl;
+            return Skipped;
+        }
+        closedStates[k] = n;
+        if(bestStateFinal && stateScore < bestStateScore) {
+            if(weight() == 1.0) {
+                //cout << "Finished: Found worse than final best. Worse: " << nodes[n].state.show() << endl;
+                _finished = true;
+                return Stopped;
+            }
+            // A weighted pass is not in score order, so just prune this state.
+            return Skipped;
+        }
+        int statePathLength = nodes[n].pathLength;
+        bool stateFinal = nodes[n].state.final();
+        bool stateBetterThanBest;
+        if(stateFinal && !bestStateFinal) {
+            stateBetterThanBest = true;
+        } else if(bestStateFinal && !stateFinal) {
+            stateBetterThanBest = false;
+        } else if(statePathLength > bestLength) {
+            stateBetterThanBest = true;
+        } else if(bestLength > statePathLength) {
+            stateBetterThanBest = false;
+        } else {
+            stateBetterThanBest = (stateScore > bestStateScore);
+        }
+        if(stateBetterThanBest) {
+            //cout << "New best with score " << stateScore << " : " << nodes[n].state.show() << endl;
+            bestNode = n;
+            bestStateScore = stateScore;
+            bestLength = statePathLength;
+            bestStateFinal = stateFinal;
+            if(stateFinal) {
+                if(_onImprovement) {
+                    _onImprovement(bestStateScore, bound());
+                }
+                // A weighted pass ends at its first final state.
+                if(weight() != 1.0) {
+                    nextPass();
+                    return Restarted;
+                }
+            }
+        }
+        _expanded++;
+        return Selected;
+    }
+    void expand(uint32_t n) {
+        int newLength = nodes[n].pathLength + 1;
+        // Successors are appended to nodes, which may reallocate, so expand from a copy.
+        const State state = nodes[n].state;
+        //cout << "New open states for " << state.show() << " :" << endl;
+        state.forEachSuccessor([this, n, newLength](const State &newState) {
+            if(closedStates.count(newState.key()) == 0) {
+                //cout << "   o: " << newState.show() << endl;
+                pushOpen(newState, n, newLength);
+            } else {
+                //cout << "   x: " << newState.show() << endl;
+            }
+        });
+    }
+    // Begin a search pass from the initial state (node 0). Nodes from earlier passes are kept,
+    // so bestNode and its parents stay valid.
+    void startPass() {
+        closedStates.clear();
+        openStates.clear();
+        const State initialState = nodes[0].state;
+        closedStates[initialState.key()] = 0;
+        //cout << "Initial state: " << initialState.show() << endl;
+        initialState.forEachSuccessor([this](const State &state) {
+            pushOpen(state, 0, 2);
+            //cout << "   next: " << state.show() << endl;
+        });
+    }
+    // Move on to the next smaller weight. Only called from weighted passes, so never the last.
+    void nextPass() {
+        _pass++;
+        startPass();
+    }
 public:
-    AStar(State initialState) : bestState(initialState) {
-        bestStateScore = initialState.scoreEstimate();
+    AStar(State initialState) : _stepSeconds(0), _pass(0), _batchSize(1) {
+        reset(initialState);
+    }
+    // Enables anytime search with the given decreasing weights, all at least 1. A final weight of 1
+    // is appended if missing. Restarts the search from the initial state.
+    void setAnytimeWeights(vector<double> weights) {
+        for(size_t i = 0; i < weights.size(); i++) {
+            if(weights[i] < 1.0 || (i > 0 && weights[i] > weights[i-1])) {
+                throw "Anytime weights must be decreasing and at least 1";
+            }
+        }
+        if(!weights.empty() && weights.back() != 1.0) {
+            weights.push_back(1.0);
+        }
+        _weights = weights;
+        const State initialState = nodes[0].state;
+        reset(initialState);
+    }
+    // Expands batches of the best open states on this many threads, batchSize states at a time
+    // (default 4 per thread). 1 thread is the plain serial search. Each batch is chosen in the same
+    // order as the serial search would expand it and only its first state may end the search, so
+    // the result matches the serial search up to ties in score.
+    void setThreads(int threads, int batchSize = 0) {
+        if(threads <= 1) {
+            _pool.reset();
+            _batchSize = 1;
+            return;
+        }
+        if(!_pool || _pool->size() != threads) {
+            _pool.reset(new ForkJoinPool(threads));
+        }
+        _batchSize = batchSize > 0 ? batchSize : 4 * threads;
+    }
+    // Called with (score, bound()) each time a better final state becomes the result.
+    void setImprovementCallback(function<void(double,double)> onImprovement) {
+        _onImprovement = onImprovement;
+    }
+    // Start a new search. Node storage is cleared but keeps its capacity, so a planner that
+    // reuses one AStar across telemetry frames does not reallocate it.
+    void reset(const State &initialState) {
+        nodes.clear();
+        closedStates.clear();
+        openStates.clear();
+        _pass = 0;
+        nodes.push_back(Node(initialState, noParent, 1, initialState.scoreEstimate()));
+        bestNode = 0;
+        bestStateScore = nodes[0].score;
         bestLength = 1;
-        initialKey = initialState.key();
         bestStateFinal = initialState.final();
         _finished = bestStateFinal;
-        closedStates[initialKey] = initialState;
-        keyToPathLength[initialKey] = 1;
-        vector<State> newStates = initialState.nextStates();
-        //cout << "Initial state: " << initialKey << endl;
+        _expanded = 0;
         if(!_finished) {
-            for (State state : newStates) {
-                string k = state.key();
-                keyToPrevKey[k] = initialKey;
-                keyToPathLength[k] = 2;
-                openStates.push(state);
-                //cout << "   next: " << k << endl;
-            }
+            startPass();
+        }
+    }
+    // Offers a known path as the result, e.g. the previous plan replayed from a new initial state.
+    // path[0] must be the initial state and each later state a successor of the one before it.
+    // The path is only kept if it ends in a final state that beats the current best, in which
+    // case the search prunes against it from then on. Returns true if it was kept.
+    bool seedPath(const vector<State> &path) {
+        if(_finished || path.empty() || !path.back().final()) {
+            return false;
+        }
+        double pathScore = path.back().scoreEstimate();
+        if(bestStateFinal && pathScore <= bestStateScore) {
+            return false;
+        }
+        uint32_t parent = 0;
+        for(size_t i = 1; i < path.size(); i++) {
+            nodes.push_back(Node(path[i], parent, int(i) + 1, path[i].scoreEstimate()));
+            parent = uint32_t(nodes.size() - 1);
+        }
+        bestNode = parent;
+        bestStateScore = pathScore;
+        bestLength = int(path.size());
+        bestStateFinal = true;
+        if(_onImprovement) {
+            _onImprovement(bestStateScore, bound());
         }
+        return true;
     }
     bool finished() {
         return _finished;
@@ -61,36 +287,67 @@ public:
     double score() {
         return bestStateScore;
     }
+    // How much better than score() the best path could still be: 0 once finished, infinite
+    // until some final state has been found. Assumes states with equal keys have equal
+    // scoreSoFar(), since closed states are never reopened.
+    double bound() {
+        if(_finished) {
+            return 0.0;
+        } else if(!bestStateFinal) {
+            return numeric_limits<double>::infinity();
+        }
+        double maxScore = bestStateScore;
+        for(const pair<double,uint32_t> &open : openStates) {
+            maxScore = max(maxScore, nodes[open.second].score);
+        }
+        return maxScore - bestStateScore;
+    }
     vector<State> path() {
         vector<State> result;
-        State nextState = bestState;
-        string nextKey = bestState.key();
-        while(true) {
-            result.push_back(nextState);
-            if(nextKey == initialKey) {
-                reverse(result.begin(), result.end());
-                return result;
-            }
-            nextKey = keyToPrevKey[nextKey];
-            nextState = closedStates[nextKey];
+        path(result);
+        return result;
+    }
+    // Same as path(), but fills result so its storage can be reused.
+    void path(vector<State> &result) {
+        result.clear();
+        for(uint32_t i = bestNode; i != noParent; i = nodes[i].parent) {
+            result.push_back(nodes[i].state);
         }
+        reverse(result.begin(), result.end());
+    }
+    size_t expanded() {
+        return _expanded;
+    }
+    size_t generated() {
+        return nodes.size(); // Includes the initial state and earlier anytime passes.
     }
     void calculateSeconds(double maxSeconds) {
-        if(_finished) {
-            return;
-        }
-        clock_t startClock = clock();
-        while(true) {
-            calculateSteps(50);
-            if(_finished) {
-                return;
-            }
-            clock_t currentClock = clock();
-            double elapsedSeconds = double(currentClock - startClock) / CLOCKS_PER_SEC;
-            if(elapsedSeconds > maxSeconds) {
-                return;
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() +
+                chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(maxSeconds));
+        calculateUntil(deadline);
+    }
+    // Searches until finished or until no more steps fit before deadline - slack.
+    // Steps run in batches sized from the measured per-step cost, so the clock is read rarely
+    // when there is plenty of time and every step when the deadline is close.
+    // Returns how far past the deadline the search stopped (negative if it stopped early).
+    chrono::steady_clock::duration calculateUntil(chrono::steady_clock::time_point deadline,
+                                                  chrono::steady_clock::duration slack = chrono::microseconds(200)) {
+        chrono::steady_clock::time_point stop = deadline - slack;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        while(!_finished && now < stop) {
+            double remainingSeconds = chrono::duration<double>(stop - now).count();
+            // Spend at most half the remaining time per batch, so a slow batch can't run far over.
+            int steps = 1;
+            if(_stepSeconds > 0) {
+                steps = (int) min(1000.0, max(1.0, 0.5 * remainingSeconds / _stepSeconds));
             }
+            calculateSteps(steps);
+            chrono::steady_clock::time_point after = chrono::steady_clock::now();
+            double batchStepSeconds = chrono::duration<double>(after - now).count() / steps;
+            _stepSeconds = (_stepSeconds > 0) ? 0.75 * _stepSeconds + 0.25 * batchStepSeconds : batchStepSeconds;
+            now = after;
         }
+        return now - deadline;
     }
     void calculateSteps(int max_steps) {
         for(int i = 0; i < max_steps; i++) {
@@ -100,61 +357,47 @@ public:
             calculateStep();
         }
     }
+    // Expands the best open state, or in parallel mode a batch of the best open states.
     void calculateStep() {
         if(_finished) {
             return;
-        } else if(openStates.empty()) {
-            //cout << "Finished: no open states" << endl;
-            _finished = true;
-            return;
-        }
-        State state = openStates.top();
-        openStates.pop();
-        string k = state.key();
-        if(closedStates.count(k) > 0) {
-            //cout << "Skip redundant key: " << k << endl;
-            return;
         }
-        closedStates[k] = state;
-        double stateScore = state.scoreEstimate();
-        if(bestStateFinal && stateScore < bestStateScore) {
-            //cout << "Finished: Found worse than final best. Worse: " << k << " Best:" << bestState.key() << endl;
-            _finished = true;
+        uint32_t n;
+        if(!_pool) {
+            if(select(true, n) == Selected) {
+                expand(n);
+            }
             return;
         }
-        int statePathLength = keyToPathLength[k];
-        bool stateFinal = state.final();
-        bool stateBetterThanBest;
-        if(stateFinal && !bestStateFinal) {
-            stateBetterThanBest = true;
-        } else if(bestStateFinal && !stateFinal) {
-            stateBetterThanBest = false;
-        } else if(statePathLength > bestLength) {
-            stateBetterThanBest = true;
-        } else if(bestLength > statePathLength) {
-            stateBetterThanBest = false;
-        } else {
-            stateBetterThanBest = (stateScore > bestStateScore);
+        // Choose the batch serially, so the closed set and best state are only written here.
+        _batch.clear();
+        while(int(_batch.size()) < _batchSize) {
+            Selection selection = select(_batch.empty(), n);
+            if(selection == Selected) {
+                _batch.push_back(n);
+            } else if(selection == Restarted) {
+                return;
+            } else if(selection == Stopped) {
+                break;
+            }
         }
-        if(stateBetterThanBest) {
-            //cout << "New best with score " << stateScore << " : " << state.key() << endl;
-            bestState = state;
-            bestStateScore = stateScore;
-            bestLength = statePathLength;
-            bestStateFinal = stateFinal;
+        // Generate and score successors in parallel. Nothing shared is written until the merge.
+        if(_expansions.size() < _batch.size()) {
+            _expansions.resize(_batch.size());
         }
-        int newLength = statePathLength + 1;
-        vector<State> newStates = state.nextStates();
-        //cout << "New open states for " << k << " :" << endl;
-        for (State newState : newStates) {
-            string kNew = newState.key();
-            if(closedStates.count(kNew) == 0) {
-                //cout << "   o: " << kNew << endl;
-                keyToPrevKey[kNew] = k;
-                keyToPathLength[kNew] = newLength;
-                openStates.push(newState);
-            } else {
-                //cout << "   x: " << kNew << endl;
+        _pool->run(int(_batch.size()), [this](int i) {
+            vector<Expansion> &out = _expansions[i];
+            out.clear();
+            nodes[_batch[i]].state.forEachSuccessor([this, &out](const State &newState) {
+                if(closedStates.count(newState.key()) == 0) {
+                    out.push_back(Expansion(newState, newState.scoreEstimate(), newState.scoreSoFar()));
+                }
+            });
+        });
+        for(size_t i = 0; i < _batch.size(); i++) {
+            int newLength = nodes[_batch[i]].pathLength + 1;
+            for(const Expansion &e : _expansions[i]) {
+                pushScored(e.state, _batch[i], newLength, e.score, e.soFar);
             }
         }
     }
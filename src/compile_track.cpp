@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include "track.h"
+
+using namespace std;
+
+// Offline compiler from a csv waypoint map to the binary format loaded by Track.
+// Usage: compile_track <map.csv> <out.trk> [bake_ds]
+// If bake_ds is given, the baked sd_to_xy table with that step is included.
+int main(int argc, char *argv[]) {
+    if(argc < 3 || argc > 4) {
+        cerr << "Usage: " << argv[0] << " <map.csv> <out.trk> [bake_ds]" << endl;
+        return 1;
+    }
+    try {
+        Track track(argv[1]);
+        if(argc == 4) {
+            track.bake(atof(argv[3]));
+        }
+        track.save_compiled(argv[2]);
+    } catch(const char *error) {
+        cerr << error << endl;
+        return 1;
+    } catch(const exception &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    cout << "Wrote " << argv[2] << endl;
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "control_message.h"
+
+namespace {
+    // Exact powers of ten, 10^19 being the largest the fast path needs.
+    const long double powers_of_ten[] = {1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+                                         1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L};
+
+    // What json.hpp does, less its locale handling, since the program never leaves the C locale.
+    size_t formatWithPrintf(double value, char *out) {
+        size_t n = size_t(snprintf(out, ControlMessageWriter::NUMBER_CHARS, "%.15g", value));
+        if(strpbrk(out, ".eE") == nullptr) {
+            out[n++] = '.';
+            out[n++] = '0';
+            out[n] = '\0';
+        }
+        return n;
+    }
+}
+
+const string &ControlMessageWriter::write(const vector<double> &next_x, const vector<double> &next_y) {
+    _buffer.clear();
+    _buffer.append("42[\"control\",{\"next_x\":");
+    appendNumbers(next_x);
+    _buffer.append(",\"next_y\":");
+    appendNumbers(next_y);
+    _buffer.append("}]");
+    return _buffer;
+}
+
+void ControlMessageWriter::appendNumbers(const vector<double> &values) {
+    char number[NUMBER_CHARS];
+    _buffer.push_back('[');
+    for(size_t i = 0; i < values.size(); i++) {
+        if(i > 0) {
+            _buffer.push_back(',');
+        }
+        _buffer.append(number, formatNumber(values[i], number));
+    }
+    _buffer.push_back(']');
+}
+
+size_t ControlMessageWriter::formatNumber(double value, char *out) {
+    // %.15g writes 1e-4 <= |value| < 1e15 without an exponent, which covers every coordinate on the
+    // track. Those are formatted here from the 15 significant digits as an integer; anything else,
+    // and any value whose digits can't be rounded with certainty, goes through printf.
+    double magnitude = fabs(value);
+    if(!(magnitude >= 1e-4 && magnitude < 1e15)) {
+        return formatWithPrintf(value, out);
+    }
+    int exponent = int(floor(log10(magnitude)));
+    if(exponent < -5 || exponent > 14) {
+        return formatWithPrintf(value, out);
+    }
+    long double scaled = magnitude * powers_of_ten[14 - exponent];
+    long double whole = floorl(scaled);
+    long double fraction = scaled - whole;
+    // The product is off by at most half an ulp, so only a fraction this close to one half is ambiguous.
+    if(fabsl(fraction - 0.5L) <= scaled * numeric_limits<long double>::epsilon()) {
+        return formatWithPrintf(value, out);
+    }
+    unsigned long long significand = (unsigned long long) whole + (fraction > 0.5L ? 1 : 0);
+    // Out of range when log10 was off by one or the rounding carried into another digit.
+    if(significand < 100000000000000ULL || significand >= 1000000000000000ULL) {
+        return formatWithPrintf(value, out);
+    }
+
+    char digits[15];
+    for(int i = 14; i >= 0; i--) {
+        digits[i] = char('0' + significand % 10);
+        significand /= 10;
+    }
+    int last = 14; // Last digit to write; %g drops trailing zeros.
+    while(last > 0 && digits[last] == '0') {
+        last--;
+    }
+
+    size_t n = 0;
+    if(value < 0) {
+        out[n++] = '-';
+    }
+    if(exponent >= 0) {
+        for(int i = 0; i <= exponent; i++) {
+            out[n++] = digits[i];
+        }
+        out[n++] = '.';
+        if(last <= exponent) {
+            out[n++] = '0'; // json.hpp's ".0" for integers.
+        }
+        for(int i = exponent + 1; i <= last; i++) {
+            out[n++] = digits[i];
+        }
+    } else {
+        out[n++] = '0';
+        out[n++] = '.';
+        for(int i = -1; i > exponent; i--) {
+            out[n++] = '0';
+        }
+        for(int i = 0; i <= last; i++) {
+            out[n++] = digits[i];
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
@@ -0,0 +1,30 @@
+#ifndef PATH_PLANNING_CONTROL_MESSAGE_H
+#define PATH_PLANNING_CONTROL_MESSAGE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Writes the control message sent back to the simulator:
+//   42["control",{"next_x":[..],"next_y":[..]}]
+// into a buffer that is reused from message to message, so once it has grown to the largest
+// message written, writing does not allocate. The bytes are the same json.hpp's dump() produced.
+class ControlMessageWriter {
+public:
+    // Longest number formatNumber writes, including the terminating '\0'.
+    static const size_t NUMBER_CHARS = 32;
+
+    // The returned message is valid until the next write.
+    const string &write(const vector<double> &next_x, const vector<double> &next_y);
+
+    // Writes value to out as json.hpp's dump() does: printf's %.15g, with ".0" appended when the
+    // result looks like an integer. Returns the number of characters written, excluding the '\0'.
+    static size_t formatNumber(double value, char *out);
+private:
+    string _buffer;
+    void appendNumbers(const vector<double> &values);
+};
+
+#endif
@@ -3,13 +3,23 @@
 #include "controller.h"
 #include "spline.h"
 
+struct ControllerWorkspace::Splines {
+    tk::spline spline_x, spline_y;
+    tk::spline_workspace solver;
+};
+
+ControllerWorkspace::ControllerWorkspace() : _splines(new Splines()) {}
+
+ControllerWorkspace::~ControllerWorkspace() {}
+
 Controller::Controller(vector<double> carx, vector<double> cary,
                        vector<double> trajx, vector<double> trajy, vector<double> trajv,
-                       double seconds_before_traj, double seconds_per_traj)
+                       double seconds_before_traj, double seconds_per_traj,
+                       ControllerWorkspace &workspace)
 {
     double minv = 0.0015 / 0.02; // Ensure at least 0.01 meters per tick to avoid rounding problems.
     double v = minv;
-    for(int i = 0; i < 10 && i < carx.size(); i++) {
+    for(int i = 0; i < 10 && i < int(carx.size()); i++) {
         _pathx.push_back(carx[i]);
         _pathy.push_back(cary[i]);
     }
@@ -25,12 +35,12 @@ Controller::Controller(vector<double> carx, vector<double> cary,
     double dt = 0.02;
 
     vector<double> spline_points_x, spline_points_y, spline_points_t;
-    for(int i = max(0,int(_pathx.size() - 2)); i < _pathx.size(); i++) {
+    for(int i = max(0,int(_pathx.size() - 2)); i < int(_pathx.size()); i++) {
         spline_points_x.push_back(_pathx[i]);
         spline_points_y.push_back(_pathy[i]);
         spline_points_t.push_back(i * dt);
     }
-    for(int i = 0; i <= ceil(expected_waypoints * dt / seconds_per_traj) && i < trajx.size(); i++) {
+    for(int i = 0; i <= ceil(expected_waypoints * dt / seconds_per_traj) && i < int(trajx.size()); i++) {
         double t = seconds_before_traj + i * seconds_per_traj;
         if(t > spline_points_t[spline_points_t.size()-1]) {
             spline_points_x.push_back(trajx[i]);
@@ -43,21 +53,27 @@ Controller::Controller(vector<double> carx, vector<double> cary,
     }
     double s = 0.0, x = _pathx[0], y = _pathy[0];
     vector<double> spline_points_s;
-    for(int i = 0; i < spline_points_x.size(); i++) {
+    for(int i = 0; i < int(spline_points_x.size()); i++) {
         double ds = sqrt(pow(spline_points_x[i] - x, 2) + pow(spline_points_y[i] - y, 2));
         s += ds;
         x = spline_points_x[i];
         y = spline_points_y[i];
         spline_points_s.push_back(s);
     }
-    tk::spline spline_x, spline_y;
-    spline_x.set_points(spline_points_s,spline_points_x);
-    spline_y.set_points(spline_points_s,spline_points_y);
+    // Refitting into the workspace's splines and solver storage does not allocate once they have grown.
+    tk::spline &spline_x = workspace._splines->spline_x;
+    tk::spline &spline_y = workspace._splines->spline_y;
+    spline_x.set_points(spline_points_s,spline_points_x,true,workspace._splines->solver);
+    spline_y.set_points(spline_points_s,spline_points_y,true,workspace._splines->solver);
 
     s = sqrt(pow(_pathx[_pathx.size()-1] - _pathx[0], 2) + pow(_pathy[_pathy.size()-1] - _pathy[0], 2));
 
-    while(_pathx.size() < expected_waypoints) {
-        double t = _pathx.size() * dt;
+    // Arc lengths of the new points only depend on the speed profile, so collect them first and then
+    // sample both splines in one increasing sweep.
+    size_t first_new = _pathx.size();
+    vector<double> path_s;
+    while(int(first_new + path_s.size()) < expected_waypoints) {
+        double t = (first_new + path_s.size()) * dt;
         double t_plus = t + lookahead_seconds;
         double t_plus_traj_passed = (t_plus - seconds_before_traj) / seconds_per_traj;
         double traj1 = max(0, int(t_plus_traj_passed));
@@ -68,17 +84,18 @@ Controller::Controller(vector<double> carx, vector<double> cary,
         v = max(minv, v + (trajv_plus - v) * dt);
 
         s = s + v * dt;
-        double x = spline_x(s);
-        double y = spline_y(s);
-        _pathx.push_back(x);
-        _pathy.push_back(y);
+        path_s.push_back(s);
     }
+    _pathx.resize(first_new + path_s.size());
+    _pathy.resize(first_new + path_s.size());
+    spline_x.eval_sorted(path_s.data(), _pathx.data() + first_new, path_s.size());
+    spline_y.eval_sorted(path_s.data(), _pathy.data() + first_new, path_s.size());
 }
 
-vector<double> Controller::pathX() {
+const vector<double> &Controller::pathX() const {
     return _pathx;
 }
 
-vector<double> Controller::pathY() {
+const vector<double> &Controller::pathY() const {
     return _pathy;
 }
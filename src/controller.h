@@ -1,19 +1,34 @@
 #ifndef PATH_PLANNING_PID_CONTROLLER_H
 #define PATH_PLANNING_PID_CONTROLLER_H
 
+#include <memory>
 #include <vector>
 
 using namespace std;
 
+// Splines and solver storage a Controller refits in place, so that once they have grown a
+// Controller does not allocate for them. Keep one per caller (e.g. per Session) and don't share
+// it between Controllers running at the same time.
+class ControllerWorkspace {
+private:
+    friend class Controller;
+    struct Splines; // Defined in controller.cpp, to keep spline.h out of this header.
+    unique_ptr<Splines> _splines;
+public:
+    ControllerWorkspace();
+    ~ControllerWorkspace();
+};
+
 class Controller {
 private:
     vector<double> _pathx, _pathy;
 public:
     Controller(vector<double> carx, vector<double> cary,
                vector<double> trajx, vector<double> trajy, vector<double> trajv,
-               double seconds_before_traj, double seconds_per_traj);
-    vector<double> pathX();
-    vector<double> pathY();
+               double seconds_before_traj, double seconds_per_traj,
+               ControllerWorkspace &workspace);
+    const vector<double> &pathX() const;
+    const vector<double> &pathY() const;
 };
 
 #endif
@@ -1,19 +1,27 @@
+#include <algorithm>
 #include "discrete_prediction.h"
 
 DiscretePrediction::DiscretePrediction(vector<int> cars_s, vector<int> cars_d, vector<int> cars_v,
                                        int crash_distance, int preferred_distance)
+: _raster_min(0), _raster_max(0), _raster_words(0), _raster_lanes(0)
 {
     _cars_s.push_back(cars_s);
     _cars_d.push_back(cars_d);
     _cars_v.push_back(cars_v);
     _crash_distance = crash_distance;
     _preferred_distance = preferred_distance;
+    for(int d : cars_d) {
+        if(d < 0) {
+            throw "DiscretePrediction lanes must not be negative";
+        }
+    }
+    index(0);
 }
 
 void DiscretePrediction::predict(int t_max) {
     for(int t = _cars_s.size(); t <= t_max; t++) {
         vector<int> new_s, new_d, new_v;
-        for(int i = 0; i < _cars_s[t-1].size(); i++) {
+        for(int i = 0; i < int(_cars_s[t-1].size()); i++) {
             int v = _cars_v[t-1][i];
             int s = _cars_s[t-1][i] + v;
             int d = _cars_d[t-1][i];
@@ -33,18 +41,45 @@ void DiscretePrediction::predict(int t_max) {
         _cars_s.push_back(new_s);
         _cars_d.push_back(new_d);
         _cars_v.push_back(new_v);
+        index(t);
+    }
+}
+
+// Builds the per-lane sorted s arrays for time t, so queries are a binary search per lane.
+void DiscretePrediction::index(int t) {
+    const vector<int> &cars_s = _cars_s[t];
+    const vector<int> &cars_d = _cars_d[t];
+    vector<pair<int,int>> by_lane; // (d, s)
+    int max_d = -1;
+    for(int i = 0; i < int(cars_s.size()); i++) {
+        by_lane.push_back(make_pair(cars_d[i], cars_s[i]));
+        max_d = max(max_d, cars_d[i]);
+    }
+    sort(by_lane.begin(), by_lane.end());
+    vector<int> lane_s, lane_start(max_d + 2, 0);
+    for(const pair<int,int> &car : by_lane) {
+        lane_s.push_back(car.second);
+        lane_start[car.first + 1]++;
+    }
+    for(int d = 0; d <= max_d; d++) {
+        lane_start[d + 1] += lane_start[d];
+    }
+    _lane_s.push_back(lane_s);
+    _lane_start.push_back(lane_start);
+    if(_raster_words > 0) {
+        raster(t);
     }
 }
 
 // Within 1 of d and within preferred_distance-1 of s
 bool DiscretePrediction::tooClose(int s, int d, int t) {
     predict(t);
-    for(int i = 0; i < _cars_s[t].size(); i++) {
-        if((s < _cars_s[t][i] + _preferred_distance)
-           && (s > _cars_s[t][i] - _preferred_distance)
-           && (d <= _cars_d[t][i] + 1)
-           && (d >= _cars_d[t][i] - 1))
-        {
+    if(rastered(s, d, t)) {
+        return testBit(_close_bits, d, t, s);
+    }
+    for(int lane = d - 1; lane <= d + 1; lane++) {
+        int car_s;
+        if(firstAbove(s - _preferred_distance, lane, t, car_s) && car_s < s + _preferred_distance) {
             return true;
         }
     }
@@ -54,25 +89,37 @@ bool DiscretePrediction::tooClose(int s, int d, int t) {
 // Same d and within crash_distance of s
 bool DiscretePrediction::crashed(int s, int d, int t) {
     predict(t);
-    for(int i = 0; i < _cars_s[t].size(); i++) {
-        if((s <= _cars_s[t][i] + _crash_distance)
-           && (s >= _cars_s[t][i] - _crash_distance)
-           && (d == _cars_d[t][i]))
-        {
-            return true;
-        }
+    if(rastered(s, d, t)) {
+        return testBit(_crash_bits, d, t, s);
     }
-    return false;
+    int car_s;
+    return firstAbove(s - _crash_distance - 1, d, t, car_s) && car_s <= s + _crash_distance;
 }
 
 int DiscretePrediction::spaceAhead(int s, int d, int t, int horizon) {
     // How many spaces are available (not tooClose) directly ahead of this spot?
     // Do not look any further than horizon.
     predict(t);
+    // The nearest car with s < car_s + preferred_distance decides, if it is closer than horizon.
+    int first = s - _preferred_distance + 1, last = s + _preferred_distance + horizon;
+    if(horizon > 0 && rastered(first, d, t) && last <= _raster_max) {
+        const uint64_t *bits = row(_ahead_bits, d, t);
+        int i = first - _raster_min, end = last - _raster_min;
+        while(i < end) {
+            uint64_t word = bits[i / 64] >> (i % 64);
+            if(word != 0) {
+                int car_s = _raster_min + i + __builtin_ctzll(word);
+                return car_s < last ? max(0, car_s - s - _preferred_distance) : horizon;
+            }
+            i = (i / 64 + 1) * 64;
+        }
+        return horizon;
+    }
     int min_dist = horizon;
-    for(int i = 0; i < _cars_s[t].size(); i++) {
-        if((d <= _cars_d[t][i] + 1) && (d >= _cars_d[t][i] - 1) && (s < _cars_s[t][i] + _preferred_distance)) {
-            int dist = _cars_s[t][i] - s - _preferred_distance;
+    for(int lane = d - 1; lane <= d + 1; lane++) {
+        int car_s;
+        if(firstAbove(s - _preferred_distance, lane, t, car_s)) {
+            int dist = car_s - s - _preferred_distance;
             min_dist = min(dist,min_dist);
             if(min_dist <= 0) {
                 return 0;
@@ -81,3 +128,79 @@ int DiscretePrediction::spaceAhead(int s, int d, int t, int horizon) {
     }
     return min_dist;
 }
+
+bool DiscretePrediction::firstAbove(int s_min, int d, int t, int &car_s) {
+    const vector<int> &start = _lane_start[t];
+    if(d < 0 || d + 1 >= int(start.size())) {
+        return false;
+    }
+    const vector<int> &lane_s = _lane_s[t];
+    vector<int>::const_iterator end = lane_s.begin() + start[d+1];
+    vector<int>::const_iterator it = upper_bound(lane_s.begin() + start[d], end, s_min);
+    if(it == end) {
+        return false;
+    }
+    car_s = *it;
+    return true;
+}
+
+void DiscretePrediction::rasterize(int s_min, int s_max, int max_d) {
+    _raster_min = s_min;
+    _raster_max = max(s_min, s_max);
+    _raster_words = (_raster_max - _raster_min + 63) / 64;
+    _raster_lanes = max(0, max_d + 1);
+    size_t size = _cars_s.size() * _raster_lanes * _raster_words;
+    _crash_bits.assign(size, 0);
+    _close_bits.assign(size, 0);
+    _ahead_bits.assign(size, 0);
+    for(int t = 0; t < int(_cars_s.size()); t++) {
+        raster(t);
+    }
+}
+
+void DiscretePrediction::raster(int t) {
+    size_t size = (t + 1) * _raster_lanes * _raster_words;
+    if(_crash_bits.size() < size) {
+        _crash_bits.resize(size, 0);
+        _close_bits.resize(size, 0);
+        _ahead_bits.resize(size, 0);
+    }
+    for(int i = 0; i < int(_cars_s[t].size()); i++) {
+        int s = _cars_s[t][i], d = _cars_d[t][i];
+        setBits(_crash_bits, d, t, s - _crash_distance, s + _crash_distance + 1);
+        for(int lane = d - 1; lane <= d + 1; lane++) {
+            setBits(_close_bits, lane, t, s - _preferred_distance + 1, s + _preferred_distance);
+            setBits(_ahead_bits, lane, t, s, s + 1);
+        }
+    }
+}
+
+bool DiscretePrediction::rastered(int s, int d, int t) const {
+    return s >= _raster_min && s < _raster_max && d >= 0 && d < _raster_lanes
+           && t < int(_cars_s.size()) && _raster_words > 0;
+}
+
+uint64_t *DiscretePrediction::row(vector<uint64_t> &bits, int d, int t) {
+    return &bits[(t * _raster_lanes + d) * _raster_words];
+}
+
+const uint64_t *DiscretePrediction::row(const vector<uint64_t> &bits, int d, int t) const {
+    return &bits[(t * _raster_lanes + d) * _raster_words];
+}
+
+// Sets the bits for s in [s_begin, s_end), clipped to the window.
+void DiscretePrediction::setBits(vector<uint64_t> &bits, int d, int t, int s_begin, int s_end) {
+    if(d < 0 || d >= _raster_lanes) {
+        return;
+    }
+    int begin = max(s_begin, _raster_min) - _raster_min, end = min(s_end, _raster_max) - _raster_min;
+    uint64_t *words = row(bits, d, t);
+    for(int i = begin; i < end; i++) {
+        words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+}
+
+bool DiscretePrediction::testBit(const vector<uint64_t> &bits, int d, int t, int s) const {
+    int i = s - _raster_min;
+    return (row(bits, d, t)[i / 64] >> (i % 64)) & 1;
+}
@@ -1,6 +1,7 @@
 #ifndef PATH_PLANNING_DISCRETE_PREDICTION_H
 #define PATH_PLANNING_DISCRETE_PREDICTION_H
 
+#include <cstdint>
 #include <vector>
 
 using namespace std;
@@ -8,10 +9,34 @@ using namespace std;
 class DiscretePrediction {
 private:
     vector<vector<int>> _cars_s, _cars_d, _cars_v;
+    // Per time step, s of every car sorted by lane and then s. Cars in lane d at time t are
+    // _lane_s[t][_lane_start[t][d]] up to _lane_s[t][_lane_start[t][d+1]].
+    vector<vector<int>> _lane_s, _lane_start;
     int _crash_distance, _preferred_distance;
-    void predict(int t);
+    // Optional bitmaps over s in [_raster_min, _raster_max) for lanes 0 to _raster_lanes-1, one bit per s,
+    // _raster_words words per (t, d) row. Queries that fall outside use the sorted arrays instead.
+    int _raster_min, _raster_max, _raster_words, _raster_lanes;
+    vector<uint64_t> _crash_bits; // s is crashed in lane d.
+    vector<uint64_t> _close_bits; // s is tooClose in lane d.
+    vector<uint64_t> _ahead_bits; // A car is at s in lane d-1, d or d+1.
+    void index(int t);
+    void raster(int t);
+    bool rastered(int s, int d, int t) const;
+    uint64_t *row(vector<uint64_t> &bits, int d, int t);
+    const uint64_t *row(const vector<uint64_t> &bits, int d, int t) const;
+    void setBits(vector<uint64_t> &bits, int d, int t, int s_begin, int s_end);
+    bool testBit(const vector<uint64_t> &bits, int d, int t, int s) const;
+    // Lowest s in lane d at time t that is greater than s_min, or false if there is none.
+    bool firstAbove(int s_min, int d, int t, int &car_s);
 public:
     DiscretePrediction(vector<int> cars_s, vector<int> cars_d, vector<int> cars_v, int crash_distance, int preferred_distance);
+    // Extends the predictions up to time t. Queries up to t are then read-only and safe to run
+    // from several threads at once.
+    void predict(int t);
+    // Rasterizes the predictions into per-(t, d) bitmaps over s in [s_min, s_max) and lanes 0 to
+    // max_d, including steps predicted later. Queries inside the window become bit tests and a
+    // find-first-set.
+    void rasterize(int s_min, int s_max, int max_d);
     bool tooClose(int s, int d, int t);
     bool crashed(int s, int d, int t);
     int spaceAhead(int s, int d, int t, int horizon);
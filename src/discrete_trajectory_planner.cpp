@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include "discrete_trajectory_planner.h"
 
 DiscreteTrajectoryPlanner::DiscreteTrajectoryPlanner(int ego_s, int ego_d, int ego_v,
@@ -5,15 +6,88 @@ DiscreteTrajectoryPlanner::DiscreteTrajectoryPlanner(int ego_s, int ego_d, int e
                                                      int simulate_steps, int horizon_steps,
                                                      int max_v, int max_a, int num_lanes,
                                                      int crash_distance, int preferred_distance)
+: _simulate_steps(simulate_steps), _horizon_steps(horizon_steps), _max_v(max_v), _max_a(max_a),
+  _num_lanes(num_lanes), _crash_distance(crash_distance), _preferred_distance(preferred_distance),
+  _plan_valid(false)
 {
+    if(simulate_steps + horizon_steps >= 128) {
+        throw "DiscreteTrajectoryPlanner supports fewer than 128 steps"; // See TrajectoryState::key.
+    }
     _start_v = ego_v;
     vector<int> other_relative_v;
     for(int abs_v : other_v) {
         other_relative_v.push_back(abs_v - _start_v);
     }
     _prediction = new DiscretePrediction(other_s,other_d,other_relative_v,crash_distance,preferred_distance);
-    TrajectoryState initialState(ego_s,ego_d,0,0,simulate_steps,horizon_steps,-ego_v,max_v-ego_v,max_a,0.0,num_lanes,_prediction);
-    _optimizer = new AStar<TrajectoryState>(initialState);
+    prepare(ego_s, ego_v);
+    _optimizer = new AStar<TrajectoryState>(initialState(ego_s, ego_d, ego_v));
+}
+
+// Predicts every step up front, so states can be scored from several threads, and rasterizes the
+// predictions over every s the ego car can reach plus room to look ahead from there.
+void DiscreteTrajectoryPlanner::prepare(int ego_s, int ego_v) {
+    _prediction->predict(_simulate_steps);
+    int s_min = ego_s - ego_v * _simulate_steps - _preferred_distance;
+    int s_max = ego_s + (_max_v - ego_v) * (_simulate_steps + _horizon_steps) + 2 * _preferred_distance;
+    _prediction->rasterize(s_min, s_max, 2 * (_num_lanes - 1));
+}
+
+// States are relative to the ego speed at the start: v and s move with a car at ego_v.
+TrajectoryState DiscreteTrajectoryPlanner::initialState(int ego_s, int ego_d, int ego_v) {
+    return TrajectoryState(ego_s,ego_d,0,0,_simulate_steps,_horizon_steps,-ego_v,_max_v-ego_v,_max_a,0.0,
+                           _num_lanes,_prediction);
+}
+
+void DiscreteTrajectoryPlanner::replan(int ego_s, int ego_d, int ego_v,
+                                       vector<int> other_s, vector<int> other_d, vector<int> other_v) {
+    vector<int> previous_d = pathD();
+    vector<int> previous_v = pathV();
+    _plan_valid = false;
+    _start_v = ego_v;
+    vector<int> other_relative_v;
+    for(int abs_v : other_v) {
+        other_relative_v.push_back(abs_v - _start_v);
+    }
+    // States keep a pointer to the prediction, so it is updated in place.
+    *_prediction = DiscretePrediction(other_s,other_d,other_relative_v,_crash_distance,_preferred_distance);
+    prepare(ego_s, ego_v);
+    _optimizer->reset(initialState(ego_s, ego_d, ego_v));
+    _optimizer->seedPath(replay(previous_d, previous_v));
+}
+
+// Follows the given absolute lanes and speeds from the current initial state as closely as each
+// step allows, holding the last ones once they run out. Index 0 is the old start and is skipped. Every state is scored under the current
+// prediction. Returns an empty path if the search has already finished at the initial state.
+vector<TrajectoryState> DiscreteTrajectoryPlanner::replay(const vector<int> &path_d, const vector<int> &path_v) {
+    vector<TrajectoryState> result = _optimizer->path();
+    if(result.size() != 1 || path_d.size() < 2) {
+        return vector<TrajectoryState>();
+    }
+    for(size_t t = 1; !result.back().final(); t++) {
+        size_t i = min(t, path_d.size() - 1);
+        int target_d = path_d[i];
+        if(t > i && target_d % 2 == 1) {
+            // Can't hold a lane line, so settle in the lane to its left.
+            target_d--;
+        }
+        int target_v = path_v[i] - _start_v;
+        TrajectoryState next;
+        int next_error = -1;
+        result.back().forEachSuccessor([&](const TrajectoryState &state) {
+            TrajectoryState candidate = state;
+            // Matching the lane matters more than matching the speed.
+            int error = 1000 * abs(candidate.d() - target_d) + abs(candidate.v() - target_v);
+            if(next_error < 0 || error < next_error) {
+                next = candidate;
+                next_error = error;
+            }
+        });
+        if(next_error < 0) {
+            return vector<TrajectoryState>();
+        }
+        result.push_back(next);
+    }
+    return result;
 }
 
 DiscreteTrajectoryPlanner::~DiscreteTrajectoryPlanner() {
@@ -29,38 +103,65 @@ double DiscreteTrajectoryPlanner::score() {
     return _optimizer->score();
 }
 
-vector<int> DiscreteTrajectoryPlanner::pathS() {
-    vector<TrajectoryState> relativePath = _optimizer->path();
-    vector<int> result;
-    for(int t = 0; t < relativePath.size(); t++) {
-        result.push_back(relativePath[t].s() + t * _start_v);
-    }
-    return result;
+double DiscreteTrajectoryPlanner::bound() {
+    return _optimizer->bound();
 }
 
-vector<int> DiscreteTrajectoryPlanner::pathD() {
-    vector<TrajectoryState> path = _optimizer->path();
-    vector<int> result;
-    for(int t = 0; t < path.size(); t++) {
-        result.push_back(path[t].d());
-    }
-    return result;
+void DiscreteTrajectoryPlanner::setAnytime(vector<double> weights, function<void(double,double)> onImprovement) {
+    _plan_valid = false;
+    _optimizer->setImprovementCallback(onImprovement);
+    _optimizer->setAnytimeWeights(weights);
+}
 
+void DiscreteTrajectoryPlanner::setThreads(int threads) {
+    _optimizer->setThreads(threads);
 }
 
-vector<int> DiscreteTrajectoryPlanner::pathV() {
-    vector<TrajectoryState> relativePath = _optimizer->path();
-    vector<int> result;
-    for(int t = 0; t < relativePath.size(); t++) {
-        result.push_back(relativePath[t].v() + _start_v);
+const DiscreteTrajectoryPlanner::Plan &DiscreteTrajectoryPlanner::plan() {
+    if(_plan_valid) {
+        return _plan;
     }
-    return result;
+    _optimizer->path(_path);
+    _plan.s.clear();
+    _plan.d.clear();
+    _plan.v.clear();
+    for(int t = 0; t < int(_path.size()); t++) {
+        _plan.s.push_back(_path[t].s() + t * _start_v);
+        _plan.d.push_back(_path[t].d());
+        _plan.v.push_back(_path[t].v() + _start_v);
+    }
+    _plan.score = _optimizer->score();
+    _plan.finished = _optimizer->finished();
+    _plan.expanded = _optimizer->expanded();
+    _plan.generated = _optimizer->generated();
+    _plan_valid = true;
+    return _plan;
+}
+
+const vector<int> &DiscreteTrajectoryPlanner::pathS() {
+    return plan().s;
+}
+
+const vector<int> &DiscreteTrajectoryPlanner::pathD() {
+    return plan().d;
+}
+
+const vector<int> &DiscreteTrajectoryPlanner::pathV() {
+    return plan().v;
 }
 
 void DiscreteTrajectoryPlanner::calculateSeconds(double maxSeconds) {
+    _plan_valid = false;
     _optimizer->calculateSeconds(maxSeconds);
 }
 
 void DiscreteTrajectoryPlanner::calculateSteps(int maxSteps) {
+    _plan_valid = false;
     _optimizer->calculateSteps(maxSteps);
 }
+
+chrono::steady_clock::duration DiscreteTrajectoryPlanner::calculateUntil(chrono::steady_clock::time_point deadline,
+                                                                         chrono::steady_clock::duration slack) {
+    _plan_valid = false;
+    return _optimizer->calculateUntil(deadline, slack);
+}
@@ -2,6 +2,8 @@
 #define PATH_PLANNING_DISCRETE_TRAJECTORY_PLANNER_H
 
 #include <vector>
+#include <chrono>
+#include <functional>
 #include "discrete_prediction.h"
 #include "astar.h"
 #include "trajectory_state.h"
@@ -9,10 +11,25 @@
 using namespace std;
 
 class DiscreteTrajectoryPlanner {
+public:
+    // Result of the search so far, in absolute s and v. Element 0 is the start.
+    struct Plan {
+        vector<int> s, d, v;
+        double score;
+        bool finished;
+        size_t expanded, generated; // States expanded and generated by the search.
+    };
 private:
     DiscretePrediction* _prediction;
     AStar<TrajectoryState>* _optimizer;
     int _start_v;
+    int _simulate_steps, _horizon_steps, _max_v, _max_a, _num_lanes, _crash_distance, _preferred_distance;
+    Plan _plan;
+    bool _plan_valid; // False once the search has moved on since _plan was built.
+    vector<TrajectoryState> _path;
+    void prepare(int ego_s, int ego_v);
+    TrajectoryState initialState(int ego_s, int ego_d, int ego_v);
+    vector<TrajectoryState> replay(const vector<int> &path_d, const vector<int> &path_v);
 public:
     DiscreteTrajectoryPlanner(int ego_s, int ego_d, int ego_v,
                               vector<int> other_s, vector<int> other_d, vector<int> other_v,
@@ -20,13 +37,27 @@ public:
                               int max_v, int max_a, int num_lanes,
                               int crash_distance, int preferred_distance);
     ~DiscreteTrajectoryPlanner();
+    // Starts a new search from a new ego state and new predictions, reusing this planner's storage.
+    // The previous plan's lane and speed choices are replayed from the new start and, if they
+    // still make a full-length path, seed the search as its incumbent result.
+    void replan(int ego_s, int ego_d, int ego_v,
+                vector<int> other_s, vector<int> other_d, vector<int> other_v);
     bool finished();
     double score();
-    vector<int> pathS();
-    vector<int> pathD();
-    vector<int> pathV();
+    double bound(); // See AStar::bound.
+    void setThreads(int threads); // See AStar::setThreads.
+    // Switches to anytime search. See AStar::setAnytimeWeights and AStar::setImprovementCallback.
+    void setAnytime(vector<double> weights, function<void(double,double)> onImprovement = nullptr);
+    // Builds the plan from the search the first time it is asked for after the search has run.
+    const Plan &plan();
+    const vector<int> &pathS();
+    const vector<int> &pathD();
+    const vector<int> &pathV();
     void calculateSeconds(double seconds);
     void calculateSteps(int steps);
+    // Returns how far past deadline the search stopped (negative if early). See AStar::calculateUntil.
+    chrono::steady_clock::duration calculateUntil(chrono::steady_clock::time_point deadline,
+                                                  chrono::steady_clock::duration slack);
 };
 
 #endif
@@ -0,0 +1,71 @@
+#include "fork_join.h"
+
+ForkJoinPool::ForkJoinPool(int threads)
+: _body(nullptr), _count(0), _next(0), _busy(0), _generation(0), _stop(false)
+{
+    for(int i = 1; i < threads; i++) {
+        _workers.push_back(thread(&ForkJoinPool::work, this));
+    }
+}
+
+ForkJoinPool::~ForkJoinPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _start.notify_all();
+    for(thread &worker : _workers) {
+        worker.join();
+    }
+}
+
+int ForkJoinPool::size() const {
+    return int(_workers.size()) + 1;
+}
+
+void ForkJoinPool::run(int count, const function<void(int)> &body) {
+    if(_workers.empty() || count <= 1) {
+        for(int i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    {
+        lock_guard<mutex> lock(_mutex);
+        _body = &body;
+        _count = count;
+        _next = 0;
+        _busy = int(_workers.size());
+        _generation++;
+    }
+    _start.notify_all();
+    runIterations();
+    unique_lock<mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _busy == 0; });
+    _body = nullptr;
+}
+
+void ForkJoinPool::runIterations() {
+    for(int i = _next++; i < _count; i = _next++) {
+        (*_body)(i);
+    }
+}
+
+void ForkJoinPool::work() {
+    unsigned seen = 0;
+    while(true) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _start.wait(lock, [this, seen] { return _stop || _generation != seen; });
+            if(_stop) {
+                return;
+            }
+            seen = _generation;
+        }
+        runIterations();
+        lock_guard<mutex> lock(_mutex);
+        if(--_busy == 0) {
+            _done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PATH_PLANNING_FORK_JOIN_H
+#define PATH_PLANNING_FORK_JOIN_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads that run the iterations of one loop at a time.
+// The calling thread takes part in each loop, so a pool of size 1 has no workers and runs inline.
+class ForkJoinPool {
+private:
+    vector<thread> _workers;
+    mutex _mutex;
+    condition_variable _start, _done;
+    const function<void(int)> *_body; // Loop body of the current run(), shared by all threads.
+    int _count;
+    atomic<int> _next;     // Next iteration to hand out.
+    int _busy;             // Workers still inside the current loop.
+    unsigned _generation;  // Incremented for each run(), so workers can tell a new loop from a spurious wakeup.
+    bool _stop;
+    void work();
+    void runIterations();
+public:
+    explicit ForkJoinPool(int threads);
+    ~ForkJoinPool();
+    int size() const;
+    // Calls body(i) for every i in [0, count) across all threads and returns when they are done.
+    // Iterations are handed out one at a time, so uneven ones balance themselves.
+    void run(int count, const function<void(int)> &body);
+};
+
+#endif
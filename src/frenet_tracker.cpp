@@ -0,0 +1,44 @@
+#include "frenet_tracker.h"
+#include <limits>
+
+FrenetTracker::FrenetTracker()
+: _calls(0)
+{
+}
+
+double FrenetTracker::hint(int id) const {
+    auto it = _last_s.find(id);
+    if(it == _last_s.end()) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    return it->second.s;
+}
+
+void FrenetTracker::update(int id, double s) {
+    _last_s[id] = Estimate{s, _calls};
+}
+
+void FrenetTracker::forget(int id) {
+    _last_s.erase(id);
+}
+
+void FrenetTracker::xyv_to_sdv(const Track &track, size_t n, const int *ids,
+                               const double *x, const double *y, const double *vx, const double *vy,
+                               double *s, double *d, double *vs, double *vd) {
+    _hints.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        _hints[i] = hint(ids[i]);
+    }
+    track.xyv_to_sdv(n, x, y, vx, vy, s, d, vs, vd, _hints.data());
+    _calls++;
+    for(size_t i = 0; i < n; i++) {
+        update(ids[i], s[i]);
+    }
+    for(auto it = _last_s.begin(); it != _last_s.end(); ) {
+        if(_calls - it->second.call > MAX_MISSED_CALLS) {
+            it = _last_s.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
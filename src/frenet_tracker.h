@@ -0,0 +1,38 @@
+#ifndef PATH_PLANNING_FRENET_TRACKER_H
+#define PATH_PLANNING_FRENET_TRACKER_H
+
+#include <unordered_map>
+#include <vector>
+#include "track.h"
+
+using namespace std;
+
+// Remembers the last s estimate of each tracked object (sensor fusion id, or the ego car)
+// so that Track projections in the next telemetry frame can be warm-started from it.
+// Estimates not updated in the last MAX_MISSED_CALLS calls to xyv_to_sdv are dropped, so cars
+// that have left sensor range do not pile up over a long connection.
+class FrenetTracker {
+private:
+    struct Estimate {
+        double s;
+        unsigned long call; // Value of _calls when s was last updated.
+    };
+    unordered_map<int,Estimate> _last_s;
+    unsigned long _calls;
+    vector<double> _hints;
+public:
+    static const int EGO_ID = -1;
+    // The server makes two calls per frame, one for sensor fusion and one for the ego car.
+    static const unsigned long MAX_MISSED_CALLS = 20;
+    FrenetTracker();
+    double hint(int id) const; // NaN if id has not been seen.
+    void update(int id, double s);
+    void forget(int id);
+
+    // Same as Track::xyv_to_sdv, but warm-started from and updating the estimates for ids.
+    void xyv_to_sdv(const Track &track, size_t n, const int *ids,
+                    const double *x, const double *y, const double *vx, const double *vy,
+                    double *s, double *d, double *vs, double *vd);
+};
+
+#endif
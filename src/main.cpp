@@ -1,194 +1,99 @@
+#include <algorithm>
 #include <fstream>
 #include <math.h>
+#include <sys/stat.h>
 #include <uWS/uWS.h>
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
 #include "Eigen-3.3/Eigen/QR"
-#include "json.hpp"
 #include "track.h"
-#include "trajectory_planner.h"
-#include "controller.h"
+#include "session.h"
+#include "thread_pool.h"
 
 using namespace std;
 
-// for convenience
-using json = nlohmann::json;
-
 double deg2rad(double x) { return x * M_PI / 180; }
 double rad2deg(double x) { return x * 180 / M_PI; }
 
-// Checks if the SocketIO event has JSON data.
-// If there is data the JSON object in string format will be returned,
-// else the empty string "" will be returned.
-string hasData(string s) {
-    auto found_null = s.find("null");
-    auto b1 = s.find_first_of("[");
-    auto b2 = s.find_first_of("}");
-    if (found_null != string::npos) {
-        return "";
-    } else if (b1 != string::npos && b2 != string::npos) {
-        return s.substr(b1, b2 - b1 + 2);
-    }
-    return "";
-}
+// A simulator connection, kept as the websocket's user data.
+struct Connection {
+    uWS::WebSocket<uWS::SERVER> socket;
+    shared_ptr<Session> session;
+};
 
 int main() {
     uWS::Hub h;
 
-    string map_file_ = "../data/highway_map.csv";
-    Track track(map_file_);
+    // Prefer the compiled map (see compile_track) when it has been built since the csv last changed.
+    string csv_file = "../data/highway_map.csv";
+    string map_file_ = "../data/highway_map.trk";
+    struct stat csv_stat, trk_stat;
+    if(stat(map_file_.c_str(), &trk_stat) != 0) {
+        map_file_ = csv_file;
+    } else if(stat(csv_file.c_str(), &csv_stat) == 0 && trk_stat.st_mtime < csv_stat.st_mtime) {
+        cout << "Compiled map is older than " << csv_file << ", rerun compile_track" << endl;
+        map_file_ = csv_file;
+    }
+    // Loaded once, then only read through a const pointer.
+    shared_ptr<Track> loaded_track = make_shared<Track>(map_file_);
+    loaded_track->bake(0.5);
+    shared_ptr<const Track> track = loaded_track;
 
     double speed_limit_mph = 47; // mph
     double speed_limit = speed_limit_mph / 2.24;
     double acceleration_limit = 9.5;
-    double jerk_limit = 10.0;
-
-    h.onMessage([&track, &speed_limit, &acceleration_limit, &jerk_limit, &speed_limit_mph](
-            uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
-            uWS::OpCode opCode) {
-
-        clock_t startClock = clock();
-
-        // "42" at the start of the message means there's a websocket message event.
-        // The 4 signifies a websocket message
-        // The 2 signifies a websocket event
-        //auto sdata = string(data).substr(0, length);
-        //cout << sdata << endl;
-
-        if (length && length > 2 && data[0] == '4' && data[1] == '2') {
-
-            auto s = hasData(data);
-
-            //cout << endl << "Receiving message: " << s << endl << endl;
-
-            if (s != "") {
-                auto j = json::parse(s);
-
-                string event = j[0].get<string>();
-
-                if (event == "telemetry") {
-                    // j[1] is the data JSON object
-
-                    // Main car's localization Data
-                    double car_x = j[1]["x"];
-                    double car_y = j[1]["y"];
-                    double car_yaw = j[1]["yaw"];
-                    double car_speed = j[1]["speed"];
-
-                    // Previous path data given to the Planner
-                    vector<double> previous_path_x = j[1]["previous_path_x"];
-                    vector<double> previous_path_y = j[1]["previous_path_y"];
-
-                    // Sensor Fusion Data, a list of all other cars on the same side of the road.
-                    auto sensor_fusion = j[1]["sensor_fusion"];
-
-                    vector<double> cars_s(0), cars_d(0), cars_vs(0), cars_vd(0);
-
-                    for(int i = 0; i < sensor_fusion.size(); i++) {
-                        double d = sensor_fusion[i][6];
-                        double sens_x = sensor_fusion[i][1];
-                        double sens_y = sensor_fusion[i][2];
-                        double sens_vx = sensor_fusion[i][3];
-                        double sens_vy = sensor_fusion[i][4];
-                        double sens_s = sensor_fusion[i][5];
-                        double sens_d = sensor_fusion[i][6];
-                        vector<double> sens_calc_sdv = track.xyv_to_sdv(sens_x,sens_y,sens_vx,sens_vy);
-                        cars_s.push_back(sens_calc_sdv[0]);
-                        cars_d.push_back(sens_calc_sdv[1]);
-                        cars_vs.push_back(sens_calc_sdv[2]);
-                        cars_vd.push_back(sens_calc_sdv[3]);
-                    }
-
-                    while(previous_path_x.size() > 50) {
-                        previous_path_x.pop_back();
-                        previous_path_y.pop_back();
-                    }
-
-                    // Predict where other cars will be at end of previous_path (assuming vs and vd are constant)
-                    double pred_time = previous_path_x.size() * 0.02;
-                    vector<double> pred_cars_s, pred_cars_d;
-                    for(int i = 0; i < cars_s.size(); i++) {
-                        pred_cars_s.push_back(cars_s[i] + pred_time * cars_vs[i]);
-                        pred_cars_d.push_back(cars_d[i] + pred_time * cars_vd[i]);
-                    }
-
-                    // Initialize Trajectory
-                    double end_of_prev_x = car_x;
-                    double end_of_prev_y = car_y;
-                    double end_of_prev_vx = 0;
-                    double end_of_prev_vy = 0;
-                    if(previous_path_x.size() > 2) {
-                        end_of_prev_x = previous_path_x[previous_path_x.size() - 1];
-                        end_of_prev_y = previous_path_y[previous_path_x.size() - 1];
-                        double before_end_of_prev_x = previous_path_x[previous_path_x.size() - 2];
-                        double before_end_of_prev_y = previous_path_y[previous_path_x.size() - 2];
-                        end_of_prev_vx = (end_of_prev_x - before_end_of_prev_x) / 0.02;
-                        end_of_prev_vy = (end_of_prev_y - before_end_of_prev_y) / 0.02;
-                    }
-
-                    vector<double> end_of_prev_sdv = track.xyv_to_sdv(end_of_prev_x,end_of_prev_y,end_of_prev_vx,end_of_prev_vy);
-
-                    // Create and use trajectory planner
-                    double lookahead_seconds = 10;
-                    TrajectoryPlanner planner(end_of_prev_sdv[0], end_of_prev_sdv[1], end_of_prev_sdv[2], 0.0,
-                                              pred_cars_s, pred_cars_d, cars_vs, cars_vd,
-                                              speed_limit, acceleration_limit, lookahead_seconds);
-                    planner.calculate(0.01);
-                    vector<double> next_s_vals = planner.pathS();
-                    vector<double> next_d_vals = planner.pathD();
-                    vector<double> next_speed_vals = planner.pathV();
-
-                    // Print out trajectory
-                    //cout << "Trajectory s/d/v:" << endl;
-                    //for(int i = 0; i < next_s_vals.size(); i++) {
-                    //    cout << "    " << next_s_vals[i] << "    " << next_d_vals[i] << "    " << next_speed_vals[i] << endl;
-                    //}
-                    //cout << "EndOfPrev x:" << end_of_prev_x << " y:" << end_of_prev_y << endl;
-
-                    // Convert trajectory from s,d to x,y
-                    vector<double> next_x_vals(0), next_y_vals(0);
-                    //cout << "Trajectory x/y:" << endl;
-                    for(int i = 0; i < next_s_vals.size(); i++) {
-                        vector<double> next_xy = track.sd_to_xy(next_s_vals[i], next_d_vals[i]);
-                        next_x_vals.push_back(next_xy[0]);
-                        next_y_vals.push_back(next_xy[1]);
-                        //cout << "    " << next_xy[0] << "    " << next_xy[1] << endl;
-                    }
-
-                    double seconds_before_traj = previous_path_x.size() * 0.02;
-                    double seconds_per_traj = 1.0;
-
-                    if(previous_path_x.size() < 1) {
-                        previous_path_x = {car_x};
-                        previous_path_y = {car_y};
-                    }
-                    
-                    Controller pid(previous_path_x, previous_path_y, next_x_vals, next_y_vals, next_speed_vals,
-                                   seconds_before_traj, seconds_per_traj);
-
-                    json msgJson;
-                    msgJson["next_x"] = pid.pathX();
-                    msgJson["next_y"] = pid.pathY();
-                    auto msg = "42[\"control\"," + msgJson.dump() + "]";
-
-                    //cout << endl << "Sending message: " << msg << endl << endl;
-
-                    clock_t endClock = clock();
-                    double elapsedSeconds = double(endClock - startClock) / CLOCKS_PER_SEC;
-                    //cout << "Callback seconds: " << elapsedSeconds << endl;
-
-                    ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-
-                }
-            } else {
-                // Manual driving
-                std::string msg = "42[\"manual\",{}]";
-                ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+
+    // Sessions plan on a shared pool, one thread per core, so several simulators can be driven at once.
+    ThreadPool pool(max(1, int(thread::hardware_concurrency())));
+    // Only touched on the websocket thread.
+    unordered_set<Connection *> connections;
+
+    // Sessions signal queued replies through the loop, which sends them on this thread.
+    function<void()> send_replies = [&connections] {
+        for(Connection *connection : connections) {
+            Session &session = *connection->session;
+            for(Session::Reply *reply = session.reply(); reply != nullptr; reply = session.reply()) {
+                //cout << endl << "Sending message: " << reply->message << endl << endl;
+                connection->socket.send(reply->message.data(), reply->message.length(), uWS::OpCode::TEXT);
+                session.releaseReply();
             }
         }
+    };
+    uv_async_t replies_ready;
+    replies_ready.data = &send_replies;
+    uv_async_init(h.getLoop(), &replies_ready, [](uv_async_t *handle) {
+        (*static_cast<function<void()> *>(handle->data))();
+    });
+
+    h.onMessage([](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length, uWS::OpCode opCode) {
+
+        // Wall-clock budgets are measured from message arrival so the whole frame stays within 20 ms.
+        chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+
+        //cout << endl << "Receiving message: " << string(data, length) << endl << endl;
+
+        Connection *connection = static_cast<Connection *>(ws.getUserData());
+        if(connection == nullptr) {
+            return;
+        }
+        Session::Frame &frame = connection->session->frame();
+        // Parsed straight from the message into the frame's reused arrays.
+        Telemetry::Result result = frame.telemetry.parse(data, length);
+
+        if (result == Telemetry::DATA) {
+            frame.arrival = frameStart;
+            connection->session->submitFrame();
+        } else if (result == Telemetry::NO_DATA) {
+            // Manual driving
+            std::string msg = "42[\"manual\",{}]";
+            ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
+        }
     });
 
     // We don't need this since we're not using HTTP but if it's removed the
@@ -204,12 +109,29 @@ int main() {
         }
     });
 
-    h.onConnection([&h](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+    h.onConnection([track, &pool, &connections, &replies_ready, speed_limit, acceleration_limit](
+            uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+        // Each connection plans from scratch with its own session.
+        Connection *connection = new Connection{ws, make_shared<Session>(
+                track, pool, speed_limit, acceleration_limit, [&replies_ready] { uv_async_send(&replies_ready); })};
+        ws.setUserData(connection);
+        connections.insert(connection);
         std::cout << "Connected!!!" << std::endl;
     });
 
-    h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
-                           char *message, size_t length) {
+    h.onDisconnection([&connections](uWS::WebSocket<uWS::SERVER> ws, int code,
+                                     char *message, size_t length) {
+        Connection *connection = static_cast<Connection *>(ws.getUserData());
+        if(connection != nullptr) {
+            // Planning already queued keeps the session alive until it is done; its replies go nowhere.
+            const Session::Stats &stats = connection->session->stats();
+            std::cout << "Planned " << stats.frames_planned << " frames, " << stats.deadlines_missed
+                      << " past the deadline by up to " << stats.max_overshoot_us << " us, dropped "
+                      << stats.frames_dropped << " with replies unsent" << std::endl;
+            connections.erase(connection);
+            ws.setUserData(nullptr);
+            delete connection;
+        }
         ws.close();
         std::cout << "Disconnected" << std::endl;
     });
@@ -0,0 +1,155 @@
+#include "session.h"
+
+Session::Session(shared_ptr<const Track> track, ThreadPool &pool, double speed_limit, double acceleration_limit,
+                 function<void()> onReply)
+: _track(track), _pool(pool), _speed_limit(speed_limit), _acceleration_limit(acceleration_limit),
+  _onReply(onReply), _scheduled(false)
+{}
+
+Session::Stats::Stats()
+: frames_planned(0), deadlines_missed(0), max_overshoot_us(0), frames_dropped(0)
+{}
+
+Session::Frame &Session::frame() {
+    return _frames.back();
+}
+
+void Session::submitFrame() {
+    _frames.publish();
+    if(!_scheduled.exchange(true)) {
+        shared_ptr<Session> self = shared_from_this();
+        _pool.submit([self] { self->planFrames(); });
+    }
+}
+
+Session::Reply *Session::reply() {
+    return _replies.front();
+}
+
+void Session::releaseReply() {
+    _replies.pop();
+}
+
+const Session::Stats &Session::stats() const {
+    return _stats;
+}
+
+void Session::planFrames() {
+    while(true) {
+        Frame *frame;
+        while((frame = _frames.take()) != nullptr) {
+            Reply *reply = _replies.back();
+            if(reply == nullptr) {
+                // Replies are not being sent, so there is nowhere to put a plan.
+                _stats.frames_dropped++;
+            } else {
+                plan(*frame, reply->message);
+                _replies.push();
+                _onReply();
+            }
+        }
+        _scheduled.store(false);
+        // A frame submitted after the last take(), but before the flag was cleared, did not schedule
+        // planning, so check again.
+        atomic_thread_fence(memory_order_seq_cst);
+        if(!_frames.fresh() || _scheduled.exchange(true)) {
+            return;
+        }
+    }
+}
+
+void Session::plan(Frame &frame, string &message) {
+    Telemetry &telemetry = frame.telemetry;
+    // Main car's localization Data
+    double car_x = telemetry.car_x;
+    double car_y = telemetry.car_y;
+
+    // Previous path data given to the Planner
+    vector<double> &previous_path_x = telemetry.previous_path_x;
+    vector<double> &previous_path_y = telemetry.previous_path_y;
+
+    // Sensor Fusion Data, a list of all other cars on the same side of the road.
+    size_t num_cars = telemetry.sensor_id.size();
+    _cars_s.resize(num_cars);
+    _cars_d.resize(num_cars);
+    _cars_vs.resize(num_cars);
+    _cars_vd.resize(num_cars);
+    _tracker.xyv_to_sdv(*_track, num_cars, telemetry.sensor_id.data(),
+                        telemetry.sensor_x.data(), telemetry.sensor_y.data(),
+                        telemetry.sensor_vx.data(), telemetry.sensor_vy.data(),
+                        _cars_s.data(), _cars_d.data(), _cars_vs.data(), _cars_vd.data());
+
+    while(previous_path_x.size() > 50) {
+        previous_path_x.pop_back();
+        previous_path_y.pop_back();
+    }
+
+    // Predict where other cars will be at end of previous_path (assuming vs and vd are constant)
+    double pred_time = previous_path_x.size() * 0.02;
+    _pred_cars_s.resize(num_cars);
+    _pred_cars_d.resize(num_cars);
+    for(size_t i = 0; i < num_cars; i++) {
+        _pred_cars_s[i] = _cars_s[i] + pred_time * _cars_vs[i];
+        _pred_cars_d[i] = _cars_d[i] + pred_time * _cars_vd[i];
+    }
+
+    // Initialize Trajectory
+    double end_of_prev_x = car_x;
+    double end_of_prev_y = car_y;
+    double end_of_prev_vx = 0;
+    double end_of_prev_vy = 0;
+    if(previous_path_x.size() > 2) {
+        end_of_prev_x = previous_path_x[previous_path_x.size() - 1];
+        end_of_prev_y = previous_path_y[previous_path_x.size() - 1];
+        double before_end_of_prev_x = previous_path_x[previous_path_x.size() - 2];
+        double before_end_of_prev_y = previous_path_y[previous_path_x.size() - 2];
+        end_of_prev_vx = (end_of_prev_x - before_end_of_prev_x) / 0.02;
+        end_of_prev_vy = (end_of_prev_y - before_end_of_prev_y) / 0.02;
+    }
+
+    double end_of_prev_sdv[4];
+    int ego_id = FrenetTracker::EGO_ID;
+    _tracker.xyv_to_sdv(*_track, 1, &ego_id, &end_of_prev_x, &end_of_prev_y, &end_of_prev_vx, &end_of_prev_vy,
+                        &end_of_prev_sdv[0], &end_of_prev_sdv[1], &end_of_prev_sdv[2], &end_of_prev_sdv[3]);
+
+    // Create or replan trajectory planner
+    double lookahead_seconds = 10;
+    if(!_planner) {
+        _planner.reset(new TrajectoryPlanner(end_of_prev_sdv[0], end_of_prev_sdv[1], end_of_prev_sdv[2], 0.0,
+                                             _pred_cars_s, _pred_cars_d, _cars_vs, _cars_vd,
+                                             _speed_limit, _acceleration_limit, lookahead_seconds));
+    } else {
+        _planner->replan(end_of_prev_sdv[0], end_of_prev_sdv[1], end_of_prev_sdv[2], 0.0,
+                         _pred_cars_s, _pred_cars_d, _cars_vs, _cars_vd);
+    }
+    // Wall-clock budgets are measured from message arrival so the whole frame stays within 20 ms.
+    chrono::steady_clock::duration overshoot = _planner->calculateUntil(frame.arrival + chrono::milliseconds(10));
+    _stats.frames_planned++;
+    if(overshoot > chrono::steady_clock::duration::zero()) {
+        _stats.deadlines_missed++;
+        long long overshoot_us = chrono::duration_cast<chrono::microseconds>(overshoot).count();
+        if(overshoot_us > _stats.max_overshoot_us) {
+            _stats.max_overshoot_us = overshoot_us;
+        }
+    }
+    const TrajectoryPlanner::Plan &plan = _planner->plan();
+
+    // Convert trajectory from s,d to x,y
+    _next_x.resize(plan.s.size());
+    _next_y.resize(plan.s.size());
+    _track->sd_to_xy(plan.s.size(), plan.s.data(), plan.d.data(), _next_x.data(), _next_y.data());
+
+    double seconds_before_traj = previous_path_x.size() * 0.02;
+    double seconds_per_traj = 1.0;
+
+    if(previous_path_x.size() < 1) {
+        previous_path_x = {car_x};
+        previous_path_y = {car_y};
+    }
+
+    Controller pid(previous_path_x, previous_path_y, _next_x, _next_y, plan.v,
+                   seconds_before_traj, seconds_per_traj, _controller_workspace);
+
+    // Copied into the reply's own buffer, which keeps its capacity from the last time around the ring.
+    message = _writer.write(pid.pathX(), pid.pathY());
+}
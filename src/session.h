@@ -0,0 +1,80 @@
+#ifndef PATH_PLANNING_SESSION_H
+#define PATH_PLANNING_SESSION_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include "control_message.h"
+#include "controller.h"
+#include "frenet_tracker.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+#include "track.h"
+#include "trajectory_planner.h"
+#include "triple_buffer.h"
+
+using namespace std;
+
+// Planning state for one simulator connection: the previous plan and its search tree, the tracker's
+// s estimates, and reused message buffers. The Track is shared, read only, with every other session.
+// The websocket thread parses telemetry into a Frame and submits it, replacing any frame not yet
+// planned. Planning then runs on the ThreadPool, for one frame of a session at a time, always from
+// the newest frame submitted. Each result is queued as a Reply for the websocket thread to send.
+// Frames and replies each have one thread on either side, so passing them takes no locks.
+// Create sessions with make_shared, since queued planning keeps a session alive until it is done.
+class Session : public enable_shared_from_this<Session> {
+public:
+    struct Frame {
+        Telemetry telemetry;
+        chrono::steady_clock::time_point arrival; // Planning deadline is measured from here.
+    };
+    struct Reply {
+        string message;
+    };
+    // Counters for monitoring. Written by planning, one frame at a time, and readable from any thread.
+    struct Stats {
+        atomic<unsigned long> frames_planned;
+        atomic<unsigned long> deadlines_missed; // Frames whose search returned after its deadline.
+        atomic<long long> max_overshoot_us;     // Largest amount by which a search missed its deadline.
+        atomic<unsigned long> frames_dropped;   // Frames not planned because the reply ring was full.
+        Stats();
+    };
+
+    // onReply is called on a pool thread each time a reply is queued.
+    Session(shared_ptr<const Track> track, ThreadPool &pool, double speed_limit, double acceleration_limit,
+            function<void()> onReply);
+
+    // Websocket thread only. Frame to fill; submitting it replaces any frame not yet planned.
+    Frame &frame();
+    void submitFrame();
+
+    // Websocket thread only. Oldest reply not yet sent, or nullptr.
+    Reply *reply();
+    void releaseReply();
+
+    const Stats &stats() const;
+private:
+    shared_ptr<const Track> _track;
+    ThreadPool &_pool;
+    double _speed_limit, _acceleration_limit;
+    function<void()> _onReply;
+    FrenetTracker _tracker;
+    unique_ptr<TrajectoryPlanner> _planner; // Kept across frames so each search starts from the previous plan.
+    ControllerWorkspace _controller_workspace;
+    ControlMessageWriter _writer;
+    vector<double> _cars_s, _cars_d, _cars_vs, _cars_vd, _pred_cars_s, _pred_cars_d;
+    vector<double> _next_x, _next_y;
+
+    TripleBuffer<Frame> _frames;
+    SpscRing<Reply, 4> _replies;
+    atomic<bool> _scheduled; // Whether planFrames is queued or running on the pool.
+    Stats _stats;
+
+    void planFrames();
+    void plan(Frame &frame, string &message);
+};
+
+#endif
@@ -31,49 +31,161 @@
 #include <cassert>
 #include <vector>
 #include <algorithm>
+// define TK_SPLINE_NO_SIMD before including to use the scalar kernels
+#if defined(__AVX__) && !defined(TK_SPLINE_NO_SIMD)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(TK_SPLINE_NO_SIMD)
+#include <emmintrin.h>
+#endif
 
 
-// unnamed namespace only because the implementation is in this
-// header file and we don't want to export symbols to the obj files
-namespace
+namespace tk
 {
 
-namespace tk
+// The definitions are inline, so every file can include this header. Each kernel choice gets its
+// own namespace so that files built with and without TK_SPLINE_NO_SIMD can be linked together.
+#if defined(__AVX__) && !defined(TK_SPLINE_NO_SIMD)
+inline namespace avx
+#elif defined(__SSE2__) && !defined(TK_SPLINE_NO_SIMD)
+inline namespace sse2
+#else
+inline namespace scalar
+#endif
 {
 
-// band matrix solver
-class band_matrix
+// 4-wide double vector for the batch evaluation kernels:
+// one AVX register if enabled at compile time (and not TK_SPLINE_NO_SIMD),
+// else two SSE2 registers, else plain scalar code
+struct vec4d
 {
-private:
-    std::vector< std::vector<double> > m_upper;  // upper band
-    std::vector< std::vector<double> > m_lower;  // lower band
-public:
-    band_matrix() {};                             // constructor
-    band_matrix(int dim, int n_u, int n_l);       // constructor
-    ~band_matrix() {};                            // destructor
-    void resize(int dim, int n_u, int n_l);      // init with dim,n_u,n_l
-    int dim() const;                             // matrix dimension
-    int num_upper() const
+#if defined(__AVX__) && !defined(TK_SPLINE_NO_SIMD)
+    __m256d v;
+    static vec4d load(const double* p)
+    {
+        vec4d r;
+        r.v=_mm256_loadu_pd(p);
+        return r;
+    }
+    void store(double* p) const
+    {
+        _mm256_storeu_pd(p, v);
+    }
+    friend vec4d operator+(vec4d a, vec4d b)
+    {
+        a.v=_mm256_add_pd(a.v, b.v);
+        return a;
+    }
+    friend vec4d operator-(vec4d a, vec4d b)
+    {
+        a.v=_mm256_sub_pd(a.v, b.v);
+        return a;
+    }
+    friend vec4d operator*(vec4d a, vec4d b)
+    {
+        a.v=_mm256_mul_pd(a.v, b.v);
+        return a;
+    }
+#elif defined(__SSE2__) && !defined(TK_SPLINE_NO_SIMD)
+    __m128d lo, hi;
+    static vec4d load(const double* p)
+    {
+        vec4d r;
+        r.lo=_mm_loadu_pd(p);
+        r.hi=_mm_loadu_pd(p+2);
+        return r;
+    }
+    void store(double* p) const
+    {
+        _mm_storeu_pd(p, lo);
+        _mm_storeu_pd(p+2, hi);
+    }
+    friend vec4d operator+(vec4d a, vec4d b)
+    {
+        a.lo=_mm_add_pd(a.lo, b.lo);
+        a.hi=_mm_add_pd(a.hi, b.hi);
+        return a;
+    }
+    friend vec4d operator-(vec4d a, vec4d b)
+    {
+        a.lo=_mm_sub_pd(a.lo, b.lo);
+        a.hi=_mm_sub_pd(a.hi, b.hi);
+        return a;
+    }
+    friend vec4d operator*(vec4d a, vec4d b)
     {
-        return m_upper.size()-1;
+        a.lo=_mm_mul_pd(a.lo, b.lo);
+        a.hi=_mm_mul_pd(a.hi, b.hi);
+        return a;
     }
-    int num_lower() const
+#else
+    double v[4];
+    static vec4d load(const double* p)
     {
-        return m_lower.size()-1;
-    }
-    // access operator
-    double & operator () (int i, int j);            // write
-    double   operator () (int i, int j) const;      // read
-    // we can store an additional diogonal (in m_lower)
-    double& saved_diag(int i);
-    double  saved_diag(int i) const;
-    void lu_decompose();
-    std::vector<double> r_solve(const std::vector<double>& b) const;
-    std::vector<double> l_solve(const std::vector<double>& b) const;
-    std::vector<double> lu_solve(const std::vector<double>& b,
-                                 bool is_lu_decomposed=false);
+        vec4d r;
+        for(int k=0; k<4; k++) r.v[k]=p[k];
+        return r;
+    }
+    void store(double* p) const
+    {
+        for(int k=0; k<4; k++) p[k]=v[k];
+    }
+    friend vec4d operator+(vec4d a, vec4d b)
+    {
+        for(int k=0; k<4; k++) a.v[k]+=b.v[k];
+        return a;
+    }
+    friend vec4d operator-(vec4d a, vec4d b)
+    {
+        for(int k=0; k<4; k++) a.v[k]-=b.v[k];
+        return a;
+    }
+    friend vec4d operator*(vec4d a, vec4d b)
+    {
+        for(int k=0; k<4; k++) a.v[k]*=b.v[k];
+        return a;
+    }
+#endif
+    static vec4d broadcast(double a)
+    {
+        double p[4]= {a, a, a, a};
+        return load(p);
+    }
+};
+
 
+// tridiagonal system lower[i]*x[i-1] + diag[i]*x[i] + upper[i]*x[i+1] = rhs[i]
+// kept between calls so that solving a system of the same or smaller size
+// does not allocate
+struct spline_workspace
+{
+    std::vector<double> lower, diag, upper, rhs;
+    void resize(int n)
+    {
+        lower.resize(n);
+        diag.resize(n);
+        upper.resize(n);
+        rhs.resize(n);
+    }
 };
+// remembers the segment found by the last evaluation, so that a sequence
+// of increasing x only walks forward over the knots instead of doing a
+// binary search per point
+struct spline_cursor
+{
+    size_t idx;
+    spline_cursor(): idx(0) {};
+};
+// find the closest knot x[idx] < v, idx=0 even if v<x[0]
+// with a cursor, walks forward from the last segment (falls back to a
+// binary search if v moved backwards)
+inline size_t find_segment(const std::vector<double>& x, double v);
+inline size_t find_segment(const std::vector<double>& x, double v, spline_cursor& c);
+
+// Thomas algorithm (no pivoting, fine for the diagonally dominant spline
+// systems): decompose overwrites diag with inverse pivots and upper with
+// the eliminated upper band, solve then works in place on any rhs
+inline void tridiagonal_decompose(spline_workspace& ws, int n);
+inline void tridiagonal_solve(const spline_workspace& ws, int n, double* rhs);
 
 
 // spline interpolation
@@ -94,6 +206,7 @@ private:
     bd_type m_left, m_right;
     double  m_left_value, m_right_value;
     bool    m_force_linear_extrapolation;
+    double eval(size_t idx, double x) const;
 
 public:
     // set default boundary condition to be zero curvature at both ends
@@ -110,7 +223,63 @@ public:
                       bool force_linear_extrapolation=false);
     void set_points(const std::vector<double>& x,
                     const std::vector<double>& y, bool cubic_spline=true);
+    // same, but solves in the given workspace; refitting a spline with no
+    // more points than before then does no heap allocation
+    void set_points(const std::vector<double>& x,
+                    const std::vector<double>& y, bool cubic_spline,
+                    spline_workspace& ws);
     double operator() (double x) const;
+    double operator() (double x, spline_cursor& c) const;
+    double deriv(int order, double x) const;
+    // ys[i] = f(xs[i]), amortised O(1) per point for increasing xs
+    // (any order is correct); evaluates 4 points at a time with vec4d
+    void eval_sorted(const double* xs, double* ys, size_t n) const;
+};
+
+
+// vector-valued cubic spline with N channels over one knot vector,
+// zero curvature at both ends (same as the spline default)
+// coefficients of all channels are interleaved per knot, so a single
+// segment search gives the value of every channel
+template <int N>
+class multispline
+{
+private:
+    std::vector<double> m_x;                // x coordinates of knots
+    // f_j(x) = a*(x-x_i)^3 + b*(x-x_i)^2 + c*(x-x_i) + y_i for channel j,
+    // stored as m_coef[(4*i+k)*N+j] with k=0..3 for y,c,b,a
+    std::vector<double> m_coef;
+    double  m_b0[N], m_c0[N];               // for left extrapol
+    void eval(size_t idx, double x, double* y) const;
+public:
+    void set_points(const std::vector<double>& x,
+                    const std::vector< std::vector<double> >& y);
+    void set_points(const std::vector<double>& x,
+                    const std::vector< std::vector<double> >& y,
+                    spline_workspace& ws);
+    // fitted state, for saving a spline and restoring it without solving:
+    // n knots, 4*N*n interleaved coefficients, N left b and c values
+    const std::vector<double>& knots() const
+    {
+        return m_x;
+    }
+    const std::vector<double>& coefficients() const
+    {
+        return m_coef;
+    }
+    const double* left_b() const
+    {
+        return m_b0;
+    }
+    const double* left_c() const
+    {
+        return m_c0;
+    }
+    void set_coefficients(const double* x, size_t n, const double* coef,
+                          const double* b0, const double* c0);
+    void operator() (double x, double* y) const;    // y[0..N-1] = f_j(x)
+    void operator() (double x, double* y, spline_cursor& c) const;
+    void deriv(double x, double* dy) const;         // dy[0..N-1] = f_j'(x)
 };
 
 
@@ -120,155 +289,63 @@ public:
 // ---------------------------------------------------------------------
 
 
-// band_matrix implementation
-// -------------------------
+// segment search implementation
+// ------------------------------
 
-band_matrix::band_matrix(int dim, int n_u, int n_l)
+inline size_t find_segment(const std::vector<double>& x, double v)
 {
-    resize(dim, n_u, n_l);
+    std::vector<double>::const_iterator it;
+    it=std::lower_bound(x.begin(),x.end(),v);
+    return std::max( int(it-x.begin())-1, 0);
 }
-void band_matrix::resize(int dim, int n_u, int n_l)
+
+inline size_t find_segment(const std::vector<double>& x, double v, spline_cursor& c)
 {
-    assert(dim>0);
-    assert(n_u>=0);
-    assert(n_l>=0);
-    m_upper.resize(n_u+1);
-    m_lower.resize(n_l+1);
-    for(size_t i=0; i<m_upper.size(); i++) {
-        m_upper[i].resize(dim);
-    }
-    for(size_t i=0; i<m_lower.size(); i++) {
-        m_lower[i].resize(dim);
+    size_t n=x.size();
+    if(c.idx>=n || (c.idx>0 && v<=x[c.idx])) {
+        c.idx=find_segment(x, v);
+        return c.idx;
     }
-}
-int band_matrix::dim() const
-{
-    if(m_upper.size()>0) {
-        return m_upper[0].size();
-    } else {
-        return 0;
+    while(c.idx+1<n && x[c.idx+1]<v) {
+        c.idx++;
     }
+    return c.idx;
 }
 
 
-// defines the new operator (), so that we can access the elements
-// by A(i,j), index going from i=0,...,dim()-1
-double & band_matrix::operator () (int i, int j)
-{
-    int k=j-i;       // what band is the entry
-    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
-    assert( (-num_lower()<=k) && (k<=num_upper()) );
-    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
-}
-double band_matrix::operator () (int i, int j) const
-{
-    int k=j-i;       // what band is the entry
-    assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
-    assert( (-num_lower()<=k) && (k<=num_upper()) );
-    // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
-}
-// second diag (used in LU decomposition), saved in m_lower
-double band_matrix::saved_diag(int i) const
-{
-    assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
-}
-double & band_matrix::saved_diag(int i)
-{
-    assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
-}
+// tridiagonal solver implementation
+// ---------------------------------
 
-// LR-Decomposition of a band matrix
-void band_matrix::lu_decompose()
+inline void tridiagonal_decompose(spline_workspace& ws, int n)
 {
-    int  i_max,j_max;
-    int  j_min;
-    double x;
-
-    // preconditioning
-    // normalize column i so that a_ii=1
-    for(int i=0; i<this->dim(); i++) {
-        assert(this->operator()(i,i)!=0.0);
-        this->saved_diag(i)=1.0/this->operator()(i,i);
-        j_min=std::max(0,i-this->num_lower());
-        j_max=std::min(this->dim()-1,i+this->num_upper());
-        for(int j=j_min; j<=j_max; j++) {
-            this->operator()(i,j) *= this->saved_diag(i);
-        }
-        this->operator()(i,i)=1.0;          // prevents rounding errors
-    }
-
-    // Gauss LR-Decomposition
-    for(int k=0; k<this->dim(); k++) {
-        i_max=std::min(this->dim()-1,k+this->num_lower());  // num_lower not a mistake!
-        for(int i=k+1; i<=i_max; i++) {
-            assert(this->operator()(k,k)!=0.0);
-            x=-this->operator()(i,k)/this->operator()(k,k);
-            this->operator()(i,k)=-x;                         // assembly part of L
-            j_max=std::min(this->dim()-1,k+this->num_upper());
-            for(int j=k+1; j<=j_max; j++) {
-                // assembly part of R
-                this->operator()(i,j)=this->operator()(i,j)+x*this->operator()(k,j);
-            }
-        }
+    assert(ws.diag[0]!=0.0);
+    ws.diag[0]=1.0/ws.diag[0];
+    ws.upper[0]*=ws.diag[0];
+    for(int i=1; i<n; i++) {
+        double pivot=ws.diag[i]-ws.lower[i]*ws.upper[i-1];
+        assert(pivot!=0.0);
+        ws.diag[i]=1.0/pivot;
+        ws.upper[i]*=ws.diag[i];
     }
 }
-// solves Ly=b
-std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
-{
-    assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
-    int j_start;
-    double sum;
-    for(int i=0; i<this->dim(); i++) {
-        sum=0;
-        j_start=std::max(0,i-this->num_lower());
-        for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
-        x[i]=(b[i]*this->saved_diag(i)) - sum;
-    }
-    return x;
-}
-// solves Rx=y
-std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
-{
-    assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
-    int j_stop;
-    double sum;
-    for(int i=this->dim()-1; i>=0; i--) {
-        sum=0;
-        j_stop=std::min(this->dim()-1,i+this->num_upper());
-        for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
-        x[i]=( b[i] - sum ) / this->operator()(i,i);
-    }
-    return x;
-}
 
-std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
-        bool is_lu_decomposed)
+inline void tridiagonal_solve(const spline_workspace& ws, int n, double* rhs)
 {
-    assert( this->dim()==(int)b.size() );
-    std::vector<double>  x,y;
-    if(is_lu_decomposed==false) {
-        this->lu_decompose();
-    }
-    y=this->l_solve(b);
-    x=this->r_solve(y);
-    return x;
+    rhs[0]*=ws.diag[0];
+    for(int i=1; i<n; i++) {
+        rhs[i]=(rhs[i]-ws.lower[i]*rhs[i-1])*ws.diag[i];
+    }
+    for(int i=n-2; i>=0; i--) {
+        rhs[i]-=ws.upper[i]*rhs[i+1];
+    }
 }
 
 
 
-
 // spline implementation
 // -----------------------
 
-void spline::set_boundary(spline::bd_type left, double left_value,
+inline void spline::set_boundary(spline::bd_type left, double left_value,
                           spline::bd_type right, double right_value,
                           bool force_linear_extrapolation)
 {
@@ -281,8 +358,16 @@ void spline::set_boundary(spline::bd_type left, double left_value,
 }
 
 
-void spline::set_points(const std::vector<double>& x,
+inline void spline::set_points(const std::vector<double>& x,
                         const std::vector<double>& y, bool cubic_spline)
+{
+    spline_workspace ws;
+    set_points(x, y, cubic_spline, ws);
+}
+
+inline void spline::set_points(const std::vector<double>& x,
+                        const std::vector<double>& y, bool cubic_spline,
+                        spline_workspace& ws)
 {
     assert(x.size()==y.size());
     assert(x.size()>2);
@@ -295,49 +380,52 @@ void spline::set_points(const std::vector<double>& x,
     }
 
     if(cubic_spline==true) { // cubic spline interpolation
-        // setting up the matrix and right hand side of the equation system
-        // for the parameters b[]
-        band_matrix A(n,1,1);
-        std::vector<double>  rhs(n);
+        // setting up the tridiagonal matrix and right hand side of the
+        // equation system for the parameters b[]
+        ws.resize(n);
         for(int i=1; i<n-1; i++) {
-            A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
-            A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
-            A(i,i+1)=1.0/3.0*(x[i+1]-x[i]);
-            rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
+            ws.lower[i]=1.0/3.0*(x[i]-x[i-1]);
+            ws.diag[i]=2.0/3.0*(x[i+1]-x[i-1]);
+            ws.upper[i]=1.0/3.0*(x[i+1]-x[i]);
+            ws.rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
         }
+        ws.lower[0]=0.0;
+        ws.upper[n-1]=0.0;
         // boundary conditions
         if(m_left == spline::second_deriv) {
             // 2*b[0] = f''
-            A(0,0)=2.0;
-            A(0,1)=0.0;
-            rhs[0]=m_left_value;
+            ws.diag[0]=2.0;
+            ws.upper[0]=0.0;
+            ws.rhs[0]=m_left_value;
         } else if(m_left == spline::first_deriv) {
             // c[0] = f', needs to be re-expressed in terms of b:
             // (2b[0]+b[1])(x[1]-x[0]) = 3 ((y[1]-y[0])/(x[1]-x[0]) - f')
-            A(0,0)=2.0*(x[1]-x[0]);
-            A(0,1)=1.0*(x[1]-x[0]);
-            rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-m_left_value);
+            ws.diag[0]=2.0*(x[1]-x[0]);
+            ws.upper[0]=1.0*(x[1]-x[0]);
+            ws.rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-m_left_value);
         } else {
             assert(false);
         }
         if(m_right == spline::second_deriv) {
             // 2*b[n-1] = f''
-            A(n-1,n-1)=2.0;
-            A(n-1,n-2)=0.0;
-            rhs[n-1]=m_right_value;
+            ws.diag[n-1]=2.0;
+            ws.lower[n-1]=0.0;
+            ws.rhs[n-1]=m_right_value;
         } else if(m_right == spline::first_deriv) {
             // c[n-1] = f', needs to be re-expressed in terms of b:
             // (b[n-2]+2b[n-1])(x[n-1]-x[n-2])
             // = 3 (f' - (y[n-1]-y[n-2])/(x[n-1]-x[n-2]))
-            A(n-1,n-1)=2.0*(x[n-1]-x[n-2]);
-            A(n-1,n-2)=1.0*(x[n-1]-x[n-2]);
-            rhs[n-1]=3.0*(m_right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
+            ws.diag[n-1]=2.0*(x[n-1]-x[n-2]);
+            ws.lower[n-1]=1.0*(x[n-1]-x[n-2]);
+            ws.rhs[n-1]=3.0*(m_right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
         } else {
             assert(false);
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        tridiagonal_decompose(ws, n);
+        tridiagonal_solve(ws, n, &ws.rhs[0]);
+        m_b.assign(ws.rhs.begin(), ws.rhs.begin()+n);
 
         // calculate parameters a[] and c[] based on b[]
         m_a.resize(n);
@@ -372,14 +460,53 @@ void spline::set_points(const std::vector<double>& x,
         m_b[n-1]=0.0;
 }
 
-double spline::operator() (double x) const
+inline double spline::operator() (double x) const
 {
-    size_t n=m_x.size();
-    // find the closest point m_x[idx] < x, idx=0 even if x<m_x[0]
-    std::vector<double>::const_iterator it;
-    it=std::lower_bound(m_x.begin(),m_x.end(),x);
-    int idx=std::max( int(it-m_x.begin())-1, 0);
+    return eval(find_segment(m_x, x), x);
+}
+
+inline double spline::operator() (double x, spline_cursor& c) const
+{
+    return eval(find_segment(m_x, x, c), x);
+}
+
+inline void spline::eval_sorted(const double* xs, double* ys, size_t n) const
+{
+    spline_cursor c;
+    size_t i=0;
+    for(; n-i>=4; i+=4) {
+        // gather the coefficients of each point's segment, then do the
+        // polynomial for all 4 points at once
+        double x0[4], y0[4], a[4], b[4], cc[4];
+        for(int k=0; k<4; k++) {
+            double x=xs[i+k];
+            size_t idx=find_segment(m_x, x, c);
+            x0[k]=m_x[idx];
+            y0[k]=m_y[idx];
+            if(x<m_x[0]) {
+                // extrapolation to the left
+                a[k]=0.0;
+                b[k]=m_b0;
+                cc[k]=m_c0;
+            } else {
+                // interpolation, or extrapolation to the right (a=0 for the last knot)
+                a[k]=m_a[idx];
+                b[k]=m_b[idx];
+                cc[k]=m_c[idx];
+            }
+        }
+        vec4d h=vec4d::load(xs+i)-vec4d::load(x0);
+        vec4d interpol=((vec4d::load(a)*h + vec4d::load(b))*h + vec4d::load(cc))*h + vec4d::load(y0);
+        interpol.store(ys+i);
+    }
+    for(; i<n; i++) {
+        ys[i]=eval(find_segment(m_x, xs[i], c), xs[i]);
+    }
+}
 
+inline double spline::eval(size_t idx, double x) const
+{
+    size_t n=m_x.size();
     double h=x-m_x[idx];
     double interpol;
     if(x<m_x[0]) {
@@ -395,10 +522,208 @@ double spline::operator() (double x) const
     return interpol;
 }
 
+inline double spline::deriv(int order, double x) const
+{
+    assert(order>0);
+    size_t n=m_x.size();
+    size_t idx=find_segment(m_x, x);
+
+    double h=x-m_x[idx];
+    double interpol;
+    if(x<m_x[0]) {
+        // extrapolation to the left
+        switch(order) {
+        case 1:
+            interpol=2.0*m_b0*h + m_c0;
+            break;
+        case 2:
+            interpol=2.0*m_b0;
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    } else if(x>m_x[n-1]) {
+        // extrapolation to the right
+        switch(order) {
+        case 1:
+            interpol=2.0*m_b[n-1]*h + m_c[n-1];
+            break;
+        case 2:
+            interpol=2.0*m_b[n-1];
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    } else {
+        // interpolation
+        switch(order) {
+        case 1:
+            interpol=(3.0*m_a[idx]*h + 2.0*m_b[idx])*h + m_c[idx];
+            break;
+        case 2:
+            interpol=6.0*m_a[idx]*h + 2.0*m_b[idx];
+            break;
+        case 3:
+            interpol=6.0*m_a[idx];
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    }
+    return interpol;
+}
 
-} // namespace tk
 
 
-} // namespace
+// multispline implementation
+// --------------------------
+
+template <int N>
+void multispline<N>::set_points(const std::vector<double>& x,
+                                const std::vector< std::vector<double> >& y)
+{
+    spline_workspace ws;
+    set_points(x, y, ws);
+}
+
+template <int N>
+void multispline<N>::set_points(const std::vector<double>& x,
+                                const std::vector< std::vector<double> >& y,
+                                spline_workspace& ws)
+{
+    assert(y.size()==N);
+    assert(x.size()>2);
+    int   n=x.size();
+    for(int i=0; i<n-1; i++) {
+        assert(x[i]<x[i+1]);
+    }
+    m_x=x;
+    m_coef.assign(4*N*n, 0.0);
+
+    // the matrix only depends on x, so it is decomposed once for all channels
+    ws.resize(n);
+    for(int i=1; i<n-1; i++) {
+        ws.lower[i]=1.0/3.0*(x[i]-x[i-1]);
+        ws.diag[i]=2.0/3.0*(x[i+1]-x[i-1]);
+        ws.upper[i]=1.0/3.0*(x[i+1]-x[i]);
+    }
+    ws.lower[0]=0.0;
+    ws.diag[0]=2.0;
+    ws.upper[0]=0.0;
+    ws.lower[n-1]=0.0;
+    ws.diag[n-1]=2.0;
+    ws.upper[n-1]=0.0;
+    tridiagonal_decompose(ws, n);
+
+    double* b=&ws.rhs[0];
+    for(int j=0; j<N; j++) {
+        const std::vector<double>& yj=y[j];
+        assert(yj.size()==x.size());
+        b[0]=0.0;
+        b[n-1]=0.0;
+        for(int i=1; i<n-1; i++) {
+            b[i]=(yj[i+1]-yj[i])/(x[i+1]-x[i]) - (yj[i]-yj[i-1])/(x[i]-x[i-1]);
+        }
+        tridiagonal_solve(ws, n, b);
+        for(int i=0; i<n-1; i++) {
+            double h=x[i+1]-x[i];
+            m_coef[(4*i+0)*N+j]=yj[i];
+            m_coef[(4*i+1)*N+j]=(yj[i+1]-yj[i])/h - 1.0/3.0*(2.0*b[i]+b[i+1])*h;
+            m_coef[(4*i+2)*N+j]=b[i];
+            m_coef[(4*i+3)*N+j]=1.0/3.0*(b[i+1]-b[i])/h;
+        }
+        // right extrapolation: f_{n-1}(x) = b*(x-x_{n-1})^2 + c*(x-x_{n-1}) + y_{n-1}
+        double h=x[n-1]-x[n-2];
+        double a2=m_coef[(4*(n-2)+3)*N+j], b2=m_coef[(4*(n-2)+2)*N+j], c2=m_coef[(4*(n-2)+1)*N+j];
+        m_coef[(4*(n-1)+0)*N+j]=yj[n-1];
+        m_coef[(4*(n-1)+1)*N+j]=3.0*a2*h*h+2.0*b2*h+c2;
+        m_coef[(4*(n-1)+2)*N+j]=b[n-1];
+        m_coef[(4*(n-1)+3)*N+j]=0.0;
+        // left extrapolation
+        m_b0[j]=b[0];
+        m_c0[j]=m_coef[1*N+j];
+    }
+}
+
+template <int N>
+void multispline<N>::set_coefficients(const double* x, size_t n, const double* coef,
+                                      const double* b0, const double* c0)
+{
+    assert(n>2);
+    m_x.assign(x, x+n);
+    m_coef.assign(coef, coef+4*N*n);
+    std::copy(b0, b0+N, m_b0);
+    std::copy(c0, c0+N, m_c0);
+}
+
+template <int N>
+void multispline<N>::operator() (double x, double* y) const
+{
+    eval(find_segment(m_x, x), x, y);
+}
+
+template <int N>
+void multispline<N>::operator() (double x, double* y, spline_cursor& c) const
+{
+    eval(find_segment(m_x, x, c), x, y);
+}
+
+template <int N>
+void multispline<N>::eval(size_t idx, double x, double* y) const
+{
+    double h=x-m_x[idx];
+    const double* coef=&m_coef[4*N*idx];
+    // channels are contiguous per coefficient, so groups of 4 channels
+    // are evaluated with vec4d
+    int j=0;
+    if(x<m_x[0]) {
+        // extrapolation to the left
+        vec4d hv=vec4d::broadcast(h);
+        for(; j+4<=N; j+=4) {
+            vec4d r=(vec4d::load(m_b0+j)*hv + vec4d::load(m_c0+j))*hv + vec4d::load(coef+j);
+            r.store(y+j);
+        }
+        for(; j<N; j++) {
+            y[j]=(m_b0[j]*h + m_c0[j])*h + coef[j];
+        }
+    } else {
+        // interpolation, or extrapolation to the right (a=0 for the last knot)
+        vec4d hv=vec4d::broadcast(h);
+        for(; j+4<=N; j+=4) {
+            vec4d r=((vec4d::load(coef+3*N+j)*hv + vec4d::load(coef+2*N+j))*hv
+                     + vec4d::load(coef+N+j))*hv + vec4d::load(coef+j);
+            r.store(y+j);
+        }
+        for(; j<N; j++) {
+            y[j]=((coef[3*N+j]*h + coef[2*N+j])*h + coef[N+j])*h + coef[j];
+        }
+    }
+}
+
+template <int N>
+void multispline<N>::deriv(double x, double* dy) const
+{
+    size_t idx=find_segment(m_x, x);
+    double h=x-m_x[idx];
+    const double* coef=&m_coef[4*N*idx];
+    if(x<m_x[0]) {
+        // extrapolation to the left
+        for(int j=0; j<N; j++) {
+            dy[j]=2.0*m_b0[j]*h + m_c0[j];
+        }
+    } else {
+        for(int j=0; j<N; j++) {
+            dy[j]=(3.0*coef[3*N+j]*h + 2.0*coef[2*N+j])*h + coef[N+j];
+        }
+    }
+}
+
+
+} // inline namespace
+
+} // namespace tk
 
 #endif /* TK_SPLINE_H */
@@ -0,0 +1,58 @@
+#ifndef PATH_PLANNING_SPSC_RING_H
+#define PATH_PLANNING_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// Fixed size queue between exactly one producer thread and one consumer thread, without locks.
+// Items are filled and read in place: the producer fills back() then push()es it, the consumer reads
+// front() then pop()s it. A slot keeps what was last written to it, so buffers inside T are reused
+// rather than reallocated once the ring has gone around.
+template<typename T, size_t Capacity>
+class SpscRing {
+private:
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    T _slots[Capacity];
+    // Count of items ever popped and pushed. Kept on separate cache lines since each is written by one thread.
+    alignas(64) atomic<size_t> _head;
+    alignas(64) atomic<size_t> _tail;
+public:
+    SpscRing() : _head(0), _tail(0) {}
+
+    // Producer only. Slot for the next item, or nullptr if the ring is full.
+    T *back() {
+        size_t tail = _tail.load(memory_order_relaxed);
+        if(tail - _head.load(memory_order_acquire) == Capacity) {
+            return nullptr;
+        }
+        return &_slots[tail & (Capacity - 1)];
+    }
+
+    // Producer only. Hands the slot from back() to the consumer.
+    void push() {
+        _tail.store(_tail.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    // Consumer only. Oldest item, or nullptr if the ring is empty.
+    T *front() {
+        size_t head = _head.load(memory_order_relaxed);
+        if(head == _tail.load(memory_order_acquire)) {
+            return nullptr;
+        }
+        return &_slots[head & (Capacity - 1)];
+    }
+
+    // Consumer only. Hands the slot from front() back to the producer.
+    void pop() {
+        _head.store(_head.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    // Exact from the consumer's side; the producer may push more at any time.
+    size_t size() const {
+        return _tail.load(memory_order_acquire) - _head.load(memory_order_acquire);
+    }
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include "telemetry.h"
+
+namespace {
+    bool equals(const char *s, size_t length, const char *key) {
+        return strlen(key) == length && memcmp(s, key, length) == 0;
+    }
+
+    bool isNumberChar(char c) {
+        return isdigit((unsigned char) c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+}
+
+Telemetry::Result Telemetry::parse(const char *data, size_t length) {
+    // "42" at the start of the message means there's a websocket message event.
+    // The 4 signifies a websocket message
+    // The 2 signifies a websocket event
+    if(length <= 2 || data[0] != '4' || data[1] != '2') {
+        return OTHER;
+    }
+    _p = data + 2;
+    _end = data + length;
+    const char *name;
+    size_t name_length;
+    if(!consume('[') || !parseString(name, name_length) || !consume(',')) {
+        return OTHER;
+    }
+    skipSpace();
+    if(_end - _p >= 4 && memcmp(_p, "null", 4) == 0) {
+        return NO_DATA;
+    }
+    if(!equals(name, name_length, "telemetry") || !consume('{')) {
+        return OTHER;
+    }
+
+    car_x = car_y = car_s = car_d = car_yaw = car_speed = 0;
+    end_path_s = end_path_d = 0;
+    previous_path_x.clear();
+    previous_path_y.clear();
+    sensor_id.clear();
+    sensor_x.clear();
+    sensor_y.clear();
+    sensor_vx.clear();
+    sensor_vy.clear();
+    sensor_s.clear();
+    sensor_d.clear();
+    if(consume('}')) {
+        return DATA;
+    }
+    while(true) {
+        const char *key;
+        size_t key_length;
+        if(!parseString(key, key_length) || !consume(':')) {
+            return OTHER;
+        }
+        bool ok;
+        if(equals(key, key_length, "x")) {
+            ok = parseNumber(car_x);
+        } else if(equals(key, key_length, "y")) {
+            ok = parseNumber(car_y);
+        } else if(equals(key, key_length, "s")) {
+            ok = parseNumber(car_s);
+        } else if(equals(key, key_length, "d")) {
+            ok = parseNumber(car_d);
+        } else if(equals(key, key_length, "yaw")) {
+            ok = parseNumber(car_yaw);
+        } else if(equals(key, key_length, "speed")) {
+            ok = parseNumber(car_speed);
+        } else if(equals(key, key_length, "end_path_s")) {
+            ok = parseNumber(end_path_s);
+        } else if(equals(key, key_length, "end_path_d")) {
+            ok = parseNumber(end_path_d);
+        } else if(equals(key, key_length, "previous_path_x")) {
+            ok = parseNumbers(previous_path_x);
+        } else if(equals(key, key_length, "previous_path_y")) {
+            ok = parseNumbers(previous_path_y);
+        } else if(equals(key, key_length, "sensor_fusion")) {
+            ok = parseSensorFusion();
+        } else {
+            ok = skipValue();
+        }
+        if(!ok) {
+            return OTHER;
+        } else if(consume('}')) {
+            break;
+        } else if(!consume(',')) {
+            return OTHER;
+        }
+    }
+    if(previous_path_x.size() != previous_path_y.size()) {
+        return OTHER;
+    }
+    return DATA;
+}
+
+void Telemetry::skipSpace() {
+    while(_p < _end && isspace((unsigned char) *_p)) {
+        _p++;
+    }
+}
+
+bool Telemetry::consume(char c) {
+    skipSpace();
+    if(_p < _end && *_p == c) {
+        _p++;
+        return true;
+    }
+    return false;
+}
+
+// Sets begin and length to the characters between the quotes. Escapes are skipped, not decoded.
+bool Telemetry::parseString(const char *&begin, size_t &length) {
+    if(!consume('"')) {
+        return false;
+    }
+    begin = _p;
+    while(_p < _end && *_p != '"') {
+        _p += (*_p == '\\') ? 2 : 1;
+    }
+    if(_p >= _end) {
+        return false;
+    }
+    length = _p - begin;
+    _p++;
+    return true;
+}
+
+bool Telemetry::parseNumber(double &value) {
+    skipSpace();
+    // strtod needs a terminated string, and the message need not be, so copy the number out.
+    char buffer[64];
+    size_t n = 0;
+    while(_p + n < _end && n < sizeof(buffer) - 1 && isNumberChar(_p[n])) {
+        buffer[n] = _p[n];
+        n++;
+    }
+    if(n == 0 || n == sizeof(buffer) - 1) {
+        return false;
+    }
+    buffer[n] = '\0';
+    char *parsed_end;
+    value = strtod(buffer, &parsed_end);
+    if(parsed_end != buffer + n) {
+        return false;
+    }
+    _p += n;
+    return true;
+}
+
+bool Telemetry::parseNumbers(vector<double> &values) {
+    if(!consume('[')) {
+        return false;
+    }
+    if(consume(']')) {
+        return true;
+    }
+    do {
+        double value;
+        if(!parseNumber(value)) {
+            return false;
+        }
+        values.push_back(value);
+    } while(consume(','));
+    return consume(']');
+}
+
+// Rows of [id, x, y, vx, vy, s, d].
+bool Telemetry::parseSensorFusion() {
+    if(!consume('[')) {
+        return false;
+    }
+    if(consume(']')) {
+        return true;
+    }
+    do {
+        double row[7];
+        if(!consume('[')) {
+            return false;
+        }
+        for(int i = 0; i < 7; i++) {
+            if((i > 0 && !consume(',')) || !parseNumber(row[i])) {
+                return false;
+            }
+        }
+        if(!consume(']')) {
+            return false;
+        }
+        sensor_id.push_back(int(row[0]));
+        sensor_x.push_back(row[1]);
+        sensor_y.push_back(row[2]);
+        sensor_vx.push_back(row[3]);
+        sensor_vy.push_back(row[4]);
+        sensor_s.push_back(row[5]);
+        sensor_d.push_back(row[6]);
+    } while(consume(','));
+    return consume(']');
+}
+
+// Skips a value of any type, e.g. for a field this parser doesn't know.
+bool Telemetry::skipValue() {
+    skipSpace();
+    if(_p >= _end) {
+        return false;
+    }
+    if(*_p == '"') {
+        const char *begin;
+        size_t length;
+        return parseString(begin, length);
+    }
+    if(*_p != '[' && *_p != '{') {
+        // Number, true, false or null.
+        const char *begin = _p;
+        while(_p < _end && *_p != ',' && *_p != ']' && *_p != '}' && !isspace((unsigned char) *_p)) {
+            _p++;
+        }
+        return _p > begin;
+    }
+    int depth = 0;
+    while(_p < _end) {
+        if(*_p == '"') {
+            const char *begin;
+            size_t length;
+            if(!parseString(begin, length)) {
+                return false;
+            }
+            continue;
+        }
+        if(*_p == '[' || *_p == '{') {
+            depth++;
+        } else if(*_p == ']' || *_p == '}') {
+            depth--;
+        }
+        _p++;
+        if(depth == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#ifndef PATH_PLANNING_TELEMETRY_H
+#define PATH_PLANNING_TELEMETRY_H
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// One telemetry event from the simulator, read straight out of the websocket message:
+//   42["telemetry",{"x":..,"y":..,"s":..,"d":..,"yaw":..,"speed":..,
+//                   "previous_path_x":[..],"previous_path_y":[..],"end_path_s":..,"end_path_d":..,
+//                   "sensor_fusion":[[id,x,y,vx,vy,s,d],..]}]
+// The arrays are reused from message to message, so once they have grown to the largest
+// message seen, parsing does not allocate.
+class Telemetry {
+public:
+    enum Result {
+        DATA,    // A telemetry event; the fields below hold its values.
+        NO_DATA, // An event without data (null), sent while the simulator is in manual mode.
+        OTHER    // Not a socket.io event, another event, or malformed. Fields may be partly overwritten.
+    };
+    double car_x, car_y, car_s, car_d, car_yaw, car_speed;
+    double end_path_s, end_path_d;
+    vector<double> previous_path_x, previous_path_y;
+    // Sensor fusion, one entry per car.
+    vector<int> sensor_id;
+    vector<double> sensor_x, sensor_y, sensor_vx, sensor_vy, sensor_s, sensor_d;
+
+    Result parse(const char *data, size_t length);
+private:
+    const char *_p, *_end; // Parse position and end of the message.
+    void skipSpace();
+    bool consume(char c);
+    bool parseString(const char *&begin, size_t &length);
+    bool parseNumber(double &value);
+    bool parseNumbers(vector<double> &values);
+    bool parseSensorFusion();
+    bool skipValue();
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+
+namespace {
+    // Pool and queue index of the worker running on this thread, so its own submissions stay local.
+    thread_local ThreadPool *current_pool = nullptr;
+    thread_local int current_queue = -1;
+}
+
+ThreadPool::ThreadPool(int threads)
+: _next_queue(0), _queued(0), _parked(0), _stop(false)
+{
+    if(threads < 1) {
+        throw "ThreadPool needs at least one thread";
+    }
+    for(int i = 0; i < threads; i++) {
+        _queues.push_back(unique_ptr<Queue>(new Queue()));
+    }
+    for(int i = 0; i < threads; i++) {
+        _workers.push_back(thread(&ThreadPool::work, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for(thread &worker : _workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return int(_workers.size());
+}
+
+void ThreadPool::submit(function<void()> task) {
+    int index = (current_pool == this) ? current_queue : int(_next_queue++ % _queues.size());
+    // Counted before the task can be taken, so take() never brings _queued below zero. A worker
+    // woken in between just looks again until the push is done.
+    _queued++;
+    {
+        lock_guard<mutex> lock(_queues[index]->guard);
+        _queues[index]->tasks.push_back(move(task));
+    }
+    // A worker about to park counts itself in _parked before checking _queued, so either it sees
+    // this task or this sees it parking. Taking the lock makes sure it is waiting before the notify.
+    if(_parked > 0) {
+        {
+            lock_guard<mutex> lock(_mutex);
+        }
+        _wake.notify_one();
+    }
+}
+
+void ThreadPool::work(int index) {
+    current_pool = this;
+    current_queue = index;
+    function<void()> task;
+    while(!_stop) {
+        if(take(index, task)) {
+            task();
+            task = nullptr; // Release what the task captured before looking for the next one.
+            continue;
+        }
+        unique_lock<mutex> lock(_mutex);
+        _parked++;
+        _wake.wait(lock, [this] { return _stop || _queued > 0; });
+        _parked--;
+    }
+}
+
+// Newest task from the worker's own deque, else the oldest from the next deque that has one.
+bool ThreadPool::take(int index, function<void()> &task) {
+    int n = int(_queues.size());
+    for(int i = 0; i < n; i++) {
+        Queue &queue = *_queues[(index + i) % n];
+        lock_guard<mutex> lock(queue.guard);
+        if(queue.tasks.empty()) {
+            continue;
+        }
+        if(i == 0) {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        _queued--;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#ifndef PATH_PLANNING_THREAD_POOL_H
+#define PATH_PLANNING_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads running independent tasks. Each worker has its own deque: tasks
+// submitted from a worker go to the back of its own deque and it takes newest first, while tasks
+// submitted from other threads are dealt round robin. A worker whose deque is empty steals the
+// oldest task from another's, so a slow task never holds up the rest. Deques are locked one at a
+// time; the pool-wide mutex is only taken to park a worker when every deque is empty, and to wake it.
+// Unlike ForkJoinPool, submit() does not wait, and the calling thread runs nothing.
+class ThreadPool {
+private:
+    struct Queue {
+        mutex guard;
+        deque<function<void()>> tasks;
+    };
+    vector<unique_ptr<Queue>> _queues; // One per worker.
+    vector<thread> _workers;
+    atomic<unsigned> _next_queue;      // Round robin position for submissions from outside the pool.
+    atomic<size_t> _queued;            // Tasks in, or being pushed to, any deque, so a worker knows when to park.
+    atomic<int> _parked;               // Workers waiting on _wake, so submit() knows when to wake one.
+    atomic<bool> _stop;
+    mutex _mutex;
+    condition_variable _wake;
+    void work(int index);
+    bool take(int index, function<void()> &task);
+public:
+    explicit ThreadPool(int threads);
+    // Waits for running tasks to finish. Tasks still queued are dropped without running.
+    ~ThreadPool();
+    int size() const;
+    void submit(function<void()> task);
+};
+
+#endif
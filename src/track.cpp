@@ -1,6 +1,54 @@
 #include "track.h"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Compiled track file layout (native byte order), see save_compiled.
+// The header is followed by these arrays, in order:
+//   double knots[num_knots], coefficients[16 * num_knots], left_b[4], left_c[4]
+//   double index_s[num_index_samples], index_x[num_index_samples], index_y[num_index_samples]
+//   int32  index_cell_start[index_cols * index_rows + 1], index_cell_samples[num_index_samples]
+//   double baked[8 * num_baked]
+static const char compiled_track_magic[8] = {'T','R','A','C','K','B','I','N'};
+static const uint32_t compiled_track_version = 1;
+
+struct CompiledTrackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t circular_track;
+    double min_waypoint_s;
+    double max_waypoint_s;
+    double endpoint_distance;
+    uint64_t num_knots;
+    uint64_t num_index_samples;
+    double index_min_x;
+    double index_min_y;
+    double index_cell_size;
+    int32_t index_cols;
+    int32_t index_rows;
+    uint64_t num_baked;
+    double baked_min_s;
+    double baked_ds;
+};
 
 Track::Track(string map_file) {
+    char magic[sizeof(compiled_track_magic)] = {0};
+    ifstream in_file(map_file.c_str(), ifstream::in | ifstream::binary);
+    in_file.read(magic, sizeof(magic));
+    in_file.close();
+    if(memcmp(magic, compiled_track_magic, sizeof(magic)) == 0) {
+        load_compiled(map_file);
+    } else {
+        load_csv(map_file);
+    }
+}
+
+// Parse waypoints from a csv map and fit the centerline splines.
+void Track::load_csv(string map_file) {
     vector<double> waypoints_x;
     vector<double> waypoints_y;
     vector<double> waypoints_s;
@@ -54,7 +102,7 @@ Track::Track(string map_file) {
             aug_dy.push_back(waypoints_dy[i]);
         }
     }
-    for(int i = 0; i < waypoints_s.size(); i++) {
+    for(int i = 0; i < int(waypoints_s.size()); i++) {
         aug_x.push_back(waypoints_x[i]);
         aug_y.push_back(waypoints_y[i]);
         aug_s.push_back(waypoints_s[i]);
@@ -73,55 +121,322 @@ Track::Track(string map_file) {
 
     // Splines to support conversion from s,d to x,y.
     // Other direction is also possible but more difficult.
-    s_x.set_points(aug_s,aug_x);
-    s_y.set_points(aug_s,aug_y);
-    s_dx.set_points(aug_s,aug_dx);
-    s_dy.set_points(aug_s,aug_dy);
-}
+    s_centerline.set_points(aug_s,{aug_x,aug_y,aug_dx,aug_dy});
 
-Track::Track(const Track &track) {
-    this->circular_track = track.circular_track;
-    this->endpoint_distance = track.endpoint_distance;
-    this->max_waypoint_s = track.max_waypoint_s;
-    this->min_waypoint_s = track.min_waypoint_s;
-    this->s_x = track.s_x;
-    this->s_y = track.s_y;
-    this->s_dx = track.s_dx;
-    this->s_dy = track.s_dy;
+    baked_min_s = min_waypoint_s;
+    baked_ds = 1.0;
+    build_index(2.0, 20.0);
 }
 
 Track::~Track() {}
 
+// Load a track written by save_compiled. The file is memory-mapped and its arrays copied straight into place,
+// so there is no parsing and no spline solving.
+void Track::load_compiled(string map_file) {
+    int fd = open(map_file.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw runtime_error("Could not open compiled track");
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error("Could not read compiled track size");
+    }
+    size_t length = st.st_size;
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+        throw runtime_error("Could not map compiled track");
+    }
+    if(length < sizeof(CompiledTrackHeader)) {
+        munmap(mapped, length);
+        throw runtime_error("Compiled track is truncated");
+    }
+    const CompiledTrackHeader *header = static_cast<const CompiledTrackHeader*>(mapped);
+    if(header->version != compiled_track_version) {
+        munmap(mapped, length);
+        throw runtime_error("Unsupported compiled track version");
+    }
+    // Bound every count by the file length first, so the expected length cannot overflow.
+    if(header->num_knots < 3 || header->num_knots > length || header->num_index_samples < 1
+       || header->num_index_samples > length || header->index_cols < 1 || header->index_rows < 1
+       || uint64_t(header->index_cols) * header->index_rows > length || header->num_baked > length
+       || !(header->index_cell_size > 0)) {
+        munmap(mapped, length);
+        throw runtime_error("Compiled track has invalid sizes");
+    }
+    size_t num_knots = header->num_knots;
+    size_t num_samples = header->num_index_samples;
+    size_t num_cells = size_t(header->index_cols) * header->index_rows;
+    size_t num_baked = header->num_baked;
+    size_t expected_length = sizeof(CompiledTrackHeader)
+                             + sizeof(double) * (num_knots * 17 + 8 + num_samples * 3 + num_baked * 8)
+                             + sizeof(int32_t) * (num_cells + 1 + num_samples);
+    if(length < expected_length) {
+        munmap(mapped, length);
+        throw runtime_error("Compiled track is truncated");
+    }
+
+    circular_track = header->circular_track != 0;
+    min_waypoint_s = header->min_waypoint_s;
+    max_waypoint_s = header->max_waypoint_s;
+    endpoint_distance = header->endpoint_distance;
+    index_min_x = header->index_min_x;
+    index_min_y = header->index_min_y;
+    index_cell_size = header->index_cell_size;
+    index_cols = header->index_cols;
+    index_rows = header->index_rows;
+    baked_min_s = header->baked_min_s;
+    baked_ds = header->baked_ds;
+
+    const double *doubles = reinterpret_cast<const double*>(header + 1);
+    const double *knots = doubles;
+    const double *coefficients = knots + num_knots;
+    const double *left_b = coefficients + 16 * num_knots;
+    const double *left_c = left_b + 4;
+    s_centerline.set_coefficients(knots, num_knots, coefficients, left_b, left_c);
+    doubles = left_c + 4;
+    index_s.assign(doubles, doubles + num_samples);
+    doubles += num_samples;
+    index_x.assign(doubles, doubles + num_samples);
+    doubles += num_samples;
+    index_y.assign(doubles, doubles + num_samples);
+    doubles += num_samples;
+    const int32_t *ints = reinterpret_cast<const int32_t*>(doubles);
+    index_cell_start.assign(ints, ints + num_cells + 1);
+    ints += num_cells + 1;
+    index_cell_samples.assign(ints, ints + num_samples);
+    ints += num_samples;
+    // The int arrays may leave the baked table unaligned, so copy it bytewise.
+    baked.resize(num_baked);
+    memcpy(baked.data(), ints, num_baked * sizeof(BakedSample));
+
+    munmap(mapped, length);
+
+    // nearest_indexed_s reads samples through the cell lists without further checks.
+    bool valid_index = index_cell_start[0] == 0 && index_cell_start[num_cells] <= int(num_samples);
+    for(size_t c = 0; c < num_cells && valid_index; c++) {
+        valid_index = index_cell_start[c] <= index_cell_start[c + 1];
+    }
+    for(size_t k = 0; k < num_samples && valid_index; k++) {
+        valid_index = index_cell_samples[k] >= 0 && index_cell_samples[k] < int(num_samples);
+    }
+    if(!valid_index) {
+        throw runtime_error("Compiled track has an invalid spatial index");
+    }
+}
+
+// Write everything needed to query the track, so that loading it does no parsing or solving.
+void Track::save_compiled(string file) const {
+    CompiledTrackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, compiled_track_magic, sizeof(header.magic));
+    header.version = compiled_track_version;
+    header.circular_track = circular_track ? 1 : 0;
+    header.min_waypoint_s = min_waypoint_s;
+    header.max_waypoint_s = max_waypoint_s;
+    header.endpoint_distance = endpoint_distance;
+    header.num_knots = s_centerline.knots().size();
+    header.num_index_samples = index_s.size();
+    header.index_min_x = index_min_x;
+    header.index_min_y = index_min_y;
+    header.index_cell_size = index_cell_size;
+    header.index_cols = index_cols;
+    header.index_rows = index_rows;
+    header.num_baked = baked.size();
+    header.baked_min_s = baked_min_s;
+    header.baked_ds = baked_ds;
+
+    ofstream out(file.c_str(), ofstream::out | ofstream::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(s_centerline.knots().data()), sizeof(double) * s_centerline.knots().size());
+    out.write(reinterpret_cast<const char*>(s_centerline.coefficients().data()), sizeof(double) * s_centerline.coefficients().size());
+    out.write(reinterpret_cast<const char*>(s_centerline.left_b()), sizeof(double) * 4);
+    out.write(reinterpret_cast<const char*>(s_centerline.left_c()), sizeof(double) * 4);
+    out.write(reinterpret_cast<const char*>(index_s.data()), sizeof(double) * index_s.size());
+    out.write(reinterpret_cast<const char*>(index_x.data()), sizeof(double) * index_x.size());
+    out.write(reinterpret_cast<const char*>(index_y.data()), sizeof(double) * index_y.size());
+    vector<int32_t> cell_start(index_cell_start.begin(), index_cell_start.end());
+    vector<int32_t> cell_samples(index_cell_samples.begin(), index_cell_samples.end());
+    out.write(reinterpret_cast<const char*>(cell_start.data()), sizeof(int32_t) * cell_start.size());
+    out.write(reinterpret_cast<const char*>(cell_samples.data()), sizeof(int32_t) * cell_samples.size());
+    out.write(reinterpret_cast<const char*>(baked.data()), sizeof(BakedSample) * baked.size());
+    if(!out) {
+        throw "Could not write compiled track";
+    }
+}
+
+// Sample the centerline every spacing meters and bucket the samples into a uniform grid of cell_size cells.
+void Track::build_index(double spacing, double cell_size) {
+    double track_distance = max_waypoint_s - min_waypoint_s + (circular_track ? endpoint_distance : 0.0);
+    int num_samples = int(track_distance / spacing) + 1;
+    index_s.resize(num_samples);
+    index_x.resize(num_samples);
+    index_y.resize(num_samples);
+    for(int i = 0; i < num_samples; i++) {
+        double s = min_waypoint_s + i * spacing;
+        double dx, dy;
+        index_s[i] = s;
+        centerline(s, index_x[i], index_y[i], dx, dy);
+    }
+
+    index_cell_size = cell_size;
+    index_min_x = *min_element(index_x.begin(), index_x.end());
+    index_min_y = *min_element(index_y.begin(), index_y.end());
+    double max_x = *max_element(index_x.begin(), index_x.end());
+    double max_y = *max_element(index_y.begin(), index_y.end());
+    index_cols = int((max_x - index_min_x) / cell_size) + 1;
+    index_rows = int((max_y - index_min_y) / cell_size) + 1;
+
+    // Counting sort of samples by cell.
+    vector<int> sample_cell(num_samples);
+    index_cell_start.assign(index_cols * index_rows + 1, 0);
+    for(int i = 0; i < num_samples; i++) {
+        int col = int((index_x[i] - index_min_x) / cell_size);
+        int row = int((index_y[i] - index_min_y) / cell_size);
+        sample_cell[i] = row * index_cols + col;
+        index_cell_start[sample_cell[i] + 1]++;
+    }
+    for(int c = 0; c < index_cols * index_rows; c++) {
+        index_cell_start[c + 1] += index_cell_start[c];
+    }
+    vector<int> fill(index_cell_start.begin(), index_cell_start.end() - 1);
+    index_cell_samples.resize(num_samples);
+    for(int i = 0; i < num_samples; i++) {
+        index_cell_samples[fill[sample_cell[i]]++] = i;
+    }
+}
+
+// s of the indexed centerline sample closest to x,y.
+// Searches rings of cells around the query until no closer sample can exist.
+double Track::nearest_indexed_s(double x, double y) const {
+    int col = int(floor((x - index_min_x) / index_cell_size));
+    int row = int(floor((y - index_min_y) / index_cell_size));
+    col = max(0, min(index_cols - 1, col));
+    row = max(0, min(index_rows - 1, row));
+    int best = -1;
+    double best_dist2 = 0;
+    int max_ring = max(index_cols, index_rows);
+    for(int ring = 0; ring <= max_ring; ring++) {
+        for(int r = row - ring; r <= row + ring; r++) {
+            if(r < 0 || r >= index_rows) {
+                continue;
+            }
+            bool edge_row = (r == row - ring || r == row + ring);
+            for(int c = col - ring; c <= col + ring; c += (edge_row ? 1 : 2 * ring)) {
+                if(c >= 0 && c < index_cols) {
+                    int cell = r * index_cols + c;
+                    for(int k = index_cell_start[cell]; k < index_cell_start[cell + 1]; k++) {
+                        int i = index_cell_samples[k];
+                        double dist2 = pow(index_x[i] - x, 2) + pow(index_y[i] - y, 2);
+                        if(best < 0 || dist2 < best_dist2) {
+                            best = i;
+                            best_dist2 = dist2;
+                        }
+                    }
+                }
+                if(ring == 0) {
+                    break;
+                }
+            }
+        }
+        // Every unvisited cell is at least ring cells away from the query.
+        if(best >= 0 && sqrt(best_dist2) <= ring * index_cell_size) {
+            break;
+        }
+    }
+    return index_s[best];
+}
+
 // Transform from Frenet s,d coordinates to Cartesian x,y
-vector<double> Track::sd_to_xy(double s, double d) {
-    double path_x = s_x(s);
-    double path_y = s_y(s);
-    double dx = s_dx(s);
-    double dy = s_dy(s);
+vector<double> Track::sd_to_xy(double s, double d) const {
+    double path_x, path_y, dx, dy;
+    centerline(s, path_x, path_y, dx, dy);
     double x = path_x + d * dx;
     double y = path_y + d * dy;
     return {x,y};
 }
 
-// Transform from Cartesian x,y to Frenet s,d
-vector<double> Track::xy_to_sd(double x, double y) {
-    double s_est = min_waypoint_s;
-    double dist2_est = pow(s_x(s_est) - x, 2) + pow(s_y(s_est) - y, 2);
-    for(int i = 1; i <= 20; i++) {
-        double s = i * (max_waypoint_s - min_waypoint_s) / 20 + min_waypoint_s;
-        double dist2 = pow(s_x(s) - x, 2) + pow(s_y(s) - y, 2);
-        if(dist2 < dist2_est) {
-            dist2_est = dist2;
-            s_est = s;
-        }
+// Batch transform from Frenet s,d to Cartesian x,y
+void Track::sd_to_xy(size_t n, const double *s, const double *d, double *x, double *y) const {
+    tk::spline_cursor cursor;
+    for(size_t i = 0; i < n; i++) {
+        double path_x, path_y, dx, dy;
+        centerline(s[i], path_x, path_y, dx, dy, cursor);
+        x[i] = path_x + d[i] * dx;
+        y[i] = path_y + d[i] * dy;
     }
-    for(int i = 0; i < 20; i++) {
-        double x_est = s_x(s_est);
-        double y_est = s_y(s_est);
+}
+
+// Centerline position and d vector at s, from the baked table when s is inside it.
+void Track::centerline(double s, double &x, double &y, double &dx, double &dy) const {
+    tk::spline_cursor cursor;
+    centerline(s, x, y, dx, dy, cursor);
+}
+
+void Track::centerline(double s, double &x, double &y, double &dx, double &dy, tk::spline_cursor &cursor) const {
+    double u = (s - baked_min_s) / baked_ds;
+    if(baked.size() >= 2 && u >= 0 && u < baked.size() - 1) {
+        int i = int(u);
+        double t = u - i;
+        const BakedSample &a = baked[i];
+        const BakedSample &b = baked[i + 1];
+        // Cubic Hermite basis, derivative terms scaled from per-meter to per-step.
+        double t2 = t * t;
+        double t3 = t2 * t;
+        double h00 = 2 * t3 - 3 * t2 + 1;
+        double h10 = (t3 - 2 * t2 + t) * baked_ds;
+        double h01 = -2 * t3 + 3 * t2;
+        double h11 = (t3 - t2) * baked_ds;
+        x = h00 * a.x + h10 * a.x_s + h01 * b.x + h11 * b.x_s;
+        y = h00 * a.y + h10 * a.y_s + h01 * b.y + h11 * b.y_s;
+        dx = h00 * a.dx + h10 * a.dx_s + h01 * b.dx + h11 * b.dx_s;
+        dy = h00 * a.dy + h10 * a.dy_s + h01 * b.dy + h11 * b.dy_s;
+        return;
+    }
+    double p[4];
+    s_centerline(s, p, cursor);
+    x = p[0];
+    y = p[1];
+    dx = p[2];
+    dy = p[3];
+}
+
+void Track::bake(double ds) {
+    if(!baked.empty() && baked_ds == ds) {
+        return;
+    }
+    double track_distance = max_waypoint_s - min_waypoint_s + (circular_track ? endpoint_distance : 0.0);
+    int num_samples = int(ceil(track_distance / ds)) + 1;
+    baked_min_s = min_waypoint_s;
+    baked_ds = ds;
+    baked.resize(num_samples);
+    for(int i = 0; i < num_samples; i++) {
+        double s = baked_min_s + i * ds;
+        double p[4], p_s[4];
+        s_centerline(s, p);
+        s_centerline.deriv(s, p_s);
+        BakedSample &sample = baked[i];
+        sample.x = p[0];
+        sample.y = p[1];
+        sample.dx = p[2];
+        sample.dy = p[3];
+        sample.x_s = p_s[0];
+        sample.y_s = p_s[1];
+        sample.dx_s = p_s[2];
+        sample.dy_s = p_s[3];
+    }
+}
+
+// Newton iteration on s towards the centerline point nearest x,y, starting from s_est.
+// Returns true if it converged within max_iterations.
+bool Track::newton_project(double x, double y, double s_est, int max_iterations, double &s, double &d) const {
+    bool converged = false;
+    for(int i = 0; i < max_iterations; i++) {
+        double x_est, y_est, dx, dy;
+        centerline(s_est, x_est, y_est, dx, dy);
         double x_diff = x - x_est;
         double y_diff = y - y_est;
-        double dx = s_dx(s_est);
-        double dy = s_dy(s_est);
         // plus_s is unit vector in direction of +s. Rotated 90 degrees counterclockwise from the (dx,dy) vector.
         double plus_s_x = 0 - dy;
         double plus_s_y = dx;
@@ -131,24 +446,70 @@ vector<double> Track::xy_to_sd(double x, double y) {
         double delta_s = x_diff * plus_s_x + y_diff * plus_s_y;
         s_est += delta_s;
         if(abs(delta_s) < 0.01) {
+            converged = true;
             break;
         }
     }
-    double x_est = s_x(s_est);
-    double y_est = s_y(s_est);
+    double x_est, y_est, dx, dy;
+    centerline(s_est, x_est, y_est, dx, dy);
     double x_diff = x - x_est;
     double y_diff = y - y_est;
-    double dx = s_dx(s_est);
-    double dy = s_dy(s_est);
     double d_mag = sqrt(pow(dx,2)+pow(dy,2));
     dx = dx / d_mag;
     dy = dy / d_mag;
-    double d_est = dx * x_diff + dy * y_diff;
-    return {s_est,d_est};
+    s = s_est;
+    d = dx * x_diff + dy * y_diff;
+    return converged;
+}
+
+// Project x,y onto the centerline, seeded from the spatial index.
+void Track::project(double x, double y, double &s, double &d) const {
+    newton_project(x, y, nearest_indexed_s(x, y), 20, s, d);
+}
+
+// Project x,y onto the centerline starting from a nearby s, e.g. the previous frame's estimate.
+// Falls back to the indexed search if the hint is NaN, or does not converge within a few steps
+// to a point near the road (a sign it started in the wrong basin).
+void Track::project(double x, double y, double s_hint, double &s, double &d) const {
+    double max_hint_d = 20.0;
+    if(!std::isnan(s_hint) && newton_project(x, y, wrap_s(s_hint), 3, s, d) && abs(d) < max_hint_d) {
+        s = wrap_s(s);
+        return;
+    }
+    project(x, y, s, d);
+}
+
+// On a circular track, bring s back into [min_waypoint_s, min_waypoint_s + track distance).
+double Track::wrap_s(double s) const {
+    if(!circular_track) {
+        return s;
+    }
+    double track_distance = max_waypoint_s - min_waypoint_s + endpoint_distance;
+    while(s < min_waypoint_s) {
+        s += track_distance;
+    }
+    while(s >= min_waypoint_s + track_distance) {
+        s -= track_distance;
+    }
+    return s;
+}
+
+// Transform from Cartesian x,y to Frenet s,d
+vector<double> Track::xy_to_sd(double x, double y) const {
+    double s, d;
+    project(x, y, s, d);
+    return {s,d};
+}
+
+// Transform from Cartesian x,y to Frenet s,d, warm-started from a nearby s
+vector<double> Track::xy_to_sd(double x, double y, double s_hint) const {
+    double s, d;
+    project(x, y, s_hint, s, d);
+    return {s,d};
 }
 
 // Transform from Frenet s,d,vs,vd coordinates to Cartesian x,y,vx,vy
-vector<double> Track::sd_to_xyv(double s, double d, double vs, double vd) {
+vector<double> Track::sd_to_xyv(double s, double d, double vs, double vd) const {
     double small = 0.01;
     vector<double> xy1 = sd_to_xy(s,d);
     double s2 = s + small * vs;
@@ -160,16 +521,34 @@ vector<double> Track::sd_to_xyv(double s, double d, double vs, double vd) {
 }
 
 // Transform from Cartesian x,y,vx,vy to Frenet s,d,vs,vd
-vector<double> Track::xyv_to_sdv(double x, double y, double vx, double vy) {
-    double small = 0.01;
-    vector<double> sd1 = xy_to_sd(x,y);
-    double x2 = x + small * vx;
-    double y2 = y + small * vy;
-    vector<double> sd2 = xy_to_sd(x2,y2);
-    double vs = (sd2[0] - sd1[0]) * (1 / small);
-    double vd = (sd2[1] - sd1[1]) * (1 / small);
-    return {sd1[0], sd1[1], vs, vd};
+vector<double> Track::xyv_to_sdv(double x, double y, double vx, double vy) const {
+    vector<double> sdv(4);
+    xyv_to_sdv(1, &x, &y, &vx, &vy, &sdv[0], &sdv[1], &sdv[2], &sdv[3]);
+    return sdv;
 }
 
-// TODO: Improve v accuracy by using dot product between v and d vector.
-// Current approach has outward bias during a curve and predicts slow lane shift when car moves at constant d.
+// Batch transform from Cartesian x,y,vx,vy to Frenet s,d,vs,vd.
+// Velocity comes from the track frame at the projected point rather than a second projection.
+// sd_to_xy is x,y = center(s) + d * normal(s), so v = [center'(s) + d * normal'(s), normal(s)] * (vs,vd)
+// and vs,vd are found by inverting that 2x2 Jacobian.
+// If s_hint is given, each projection is warm-started from it (NaN entries mean no hint).
+void Track::xyv_to_sdv(size_t n, const double *x, const double *y, const double *vx, const double *vy,
+                       double *s, double *d, double *vs, double *vd, const double *s_hint) const {
+    for(size_t i = 0; i < n; i++) {
+        if(s_hint) {
+            project(x[i], y[i], s_hint[i], s[i], d[i]);
+        } else {
+            project(x[i], y[i], s[i], d[i]);
+        }
+        double p[4], p_s[4];
+        s_centerline(s[i], p);
+        s_centerline.deriv(s[i], p_s);
+        double ds_x = p_s[0] + d[i] * p_s[2];
+        double ds_y = p_s[1] + d[i] * p_s[3];
+        double dd_x = p[2];
+        double dd_y = p[3];
+        double det = ds_x * dd_y - ds_y * dd_x;
+        vs[i] = (vx[i] * dd_y - vy[i] * dd_x) / det;
+        vd[i] = (ds_x * vy[i] - ds_y * vx[i]) / det;
+    }
+}
@@ -7,37 +7,97 @@
 #include <sstream>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 #include "spline.h"
+#include "aligned_allocator.h"
 
 using namespace std;
 
 class Track {
 public:
+    // map_file is either a csv of waypoints (x y s dx dy per line) or a file written by save_compiled.
+    // A compiled file is not checked against the csv it came from; rebuild it when the csv changes.
     explicit Track(string map_file);
-    Track(const Track &track);
     virtual ~Track();
 
+    // After construction (and bake, if used) a Track is only read: all queries are const and keep no
+    // state between calls, so one instance can be shared, e.g. as shared_ptr<const Track>, and
+    // queried from several threads without locking.
+
     // Transform from Frenet s,d coordinates to Cartesian x,y
-    vector<double> sd_to_xy(double s, double d);
+    vector<double> sd_to_xy(double s, double d) const;
+
+    // Batch transform from Frenet s,d to Cartesian x,y for n points, e.g. a planned path.
+    // Increasing s is cheapest: the spline segment search walks forward from the previous point.
+    void sd_to_xy(size_t n, const double *s, const double *d, double *x, double *y) const;
+
+    // Resample the centerline into a fixed-step table so that sd_to_xy uses index arithmetic and
+    // cubic Hermite interpolation instead of four spline searches. ds is the table step in meters.
+    void bake(double ds = 0.5);
+
+    // Write a compiled track (splines, spatial index and baked table if any) that loads without parsing or solving.
+    void save_compiled(string file) const;
 
     // Transform from Cartesian x,y to Frenet s,d
-    vector<double> xy_to_sd(double x, double y);
+    vector<double> xy_to_sd(double x, double y) const;
+
+    // Transform from Cartesian x,y to Frenet s,d, starting from a nearby s such as the last known s of
+    // the same car. Falls back to the global search if the hint does not converge.
+    vector<double> xy_to_sd(double x, double y, double s_hint) const;
 
     // Transform from Frenet s,d,vs,vd coordinates to Cartesian x,y,vx,vy
-    vector<double> sd_to_xyv(double s, double d, double vs, double vd);
+    vector<double> sd_to_xyv(double s, double d, double vs, double vd) const;
 
     // Transform from Cartesian x,y,vx,vy to Frenet s,d,vs,vd
-    vector<double> xyv_to_sdv(double x, double y, double vx, double vy);
+    vector<double> xyv_to_sdv(double x, double y, double vx, double vy) const;
+
+    // Batch transform from Cartesian x,y,vx,vy to Frenet s,d,vs,vd for n points.
+    // Inputs and outputs are caller-owned arrays of length n. Does not allocate.
+    // Optional s_hint warm-starts each projection (NaN entries mean no hint).
+    void xyv_to_sdv(size_t n, const double *x, const double *y, const double *vx, const double *vy,
+                    double *s, double *d, double *vs, double *vd, const double *s_hint = nullptr) const;
 
 private:
-    tk::spline s_x;
-    tk::spline s_y;
-    tk::spline s_dx;
-    tk::spline s_dy;
+    void load_csv(string map_file);
+    void load_compiled(string map_file);
+
+    // Centerline x, y and d vector dx, dy as functions of s, in that channel order.
+    tk::multispline<4> s_centerline;
     bool circular_track;
     double min_waypoint_s;
     double max_waypoint_s;
     double endpoint_distance;
+
+    // Spatial index over densely sampled centerline points, used to seed xy_to_sd.
+    // Samples are bucketed into a uniform grid; cell_start[c]..cell_start[c+1] are the
+    // positions in cell_samples of the samples that fall into cell c.
+    vector<double> index_s;
+    vector<double> index_x;
+    vector<double> index_y;
+    vector<int> index_cell_start;
+    vector<int> index_cell_samples;
+    double index_min_x;
+    double index_min_y;
+    double index_cell_size;
+    int index_cols;
+    int index_rows;
+    void build_index(double spacing, double cell_size);
+    double nearest_indexed_s(double x, double y) const;
+    bool newton_project(double x, double y, double s_est, int max_iterations, double &s, double &d) const;
+    void project(double x, double y, double &s, double &d) const;
+    void project(double x, double y, double s_hint, double &s, double &d) const;
+    double wrap_s(double s) const;
+
+    // Baked centerline table (see bake). One cache line per sample: position, normal and their derivatives by s.
+    struct BakedSample {
+        double x, y, dx, dy;
+        double x_s, y_s, dx_s, dy_s;
+    };
+    vector<BakedSample, aligned_allocator<BakedSample, 64>> baked;
+    double baked_min_s;
+    double baked_ds;
+    void centerline(double s, double &x, double &y, double &dx, double &dy) const;
+    void centerline(double s, double &x, double &y, double &dx, double &dy, tk::spline_cursor &cursor) const;
 };
 
 #endif
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iostream>
 #include "trajectory_planner.h"
 
@@ -8,19 +9,44 @@ TrajectoryPlanner::TrajectoryPlanner(double s, double d, double vs, double vd,
 
         : _s(s), _d(d), _vs(vs), _vd(vd), _other_s(other_s), _other_d(other_d), _other_vs(other_vs), _other_vd(other_vd),
           _max_vs(max_vs), _max_as(max_as), _lookahead_seconds(lookahead_seconds),
-          _discrete_max_v(max(1,(int) floor(max_vs+0.1)))
+          _discrete_max_v(max(1,(int) floor(max_vs+0.1))), _discrete_planner(nullptr),
+          _plan_valid(false)
 {
-    int discrete_max_a = max(1, (int) floor(max_as+0.1));
+    replan(s, d, vs, vd, other_s, other_d, other_vs, other_vd);
+}
+
+TrajectoryPlanner::~TrajectoryPlanner() {
+    delete _discrete_planner;
+}
+
+void TrajectoryPlanner::replan(double s, double d, double vs, double vd,
+                               vector<double> other_s, vector<double> other_d,
+                               vector<double> other_vs, vector<double> other_vd) {
+    _s = s;
+    _d = d;
+    _vs = vs;
+    _vd = vd;
+    _other_s = other_s;
+    _other_d = other_d;
+    _other_vs = other_vs;
+    _other_vd = other_vd;
+    _plan_valid = false;
+    int discrete_max_a = max(1, (int) floor(_max_as+0.1));
     int discrete_s = convert_s_to_discrete(s);
     int discrete_d = convert_d_to_discrete(d, vd);
     int discrete_v = convert_v_to_discrete(vs);
     vector<int> discrete_other_s, discrete_other_d, discrete_other_v;
-    for(int i = 0; i < other_s.size(); i++) {
+    for(int i = 0; i < int(other_s.size()); i++) {
         discrete_other_s.push_back(convert_s_to_discrete(other_s[i]));
         discrete_other_d.push_back(convert_d_to_discrete(other_d[i],other_vd[i]));
         discrete_other_v.push_back(convert_v_to_discrete(other_vs[i]));
     }
-    int discrete_lookahead_seconds = (int) ceil(lookahead_seconds);
+    if(_discrete_planner != nullptr) {
+        _discrete_planner->replan(discrete_s,discrete_d,discrete_v,
+                                  discrete_other_s,discrete_other_d,discrete_other_v);
+        return;
+    }
+    int discrete_lookahead_seconds = (int) ceil(_lookahead_seconds);
     int horizon = 10;
     int num_lanes = 3;
     int crash_distance = 3;
@@ -31,56 +57,66 @@ TrajectoryPlanner::TrajectoryPlanner(double s, double d, double vs, double vd,
                                           discrete_lookahead_seconds, horizon,
                                           _discrete_max_v, discrete_max_a, num_lanes,
                                           crash_distance, preferred_distance);
+    // Get a full-length plan early in crowded traffic, then refine it for the rest of the budget.
+    _discrete_planner->setAnytime({10.0, 3.0, 1.5});
 }
 
-TrajectoryPlanner::~TrajectoryPlanner() {
-    delete _discrete_planner;
+void TrajectoryPlanner::setThreads(int threads) {
+    _discrete_planner->setThreads(threads);
 }
 
 void TrajectoryPlanner::calculate(double calc_time_limit_seconds) {
+    _plan_valid = false;
     _discrete_planner->calculateSeconds(calc_time_limit_seconds);
 }
 
-vector<double> TrajectoryPlanner::pathS() {
-    vector<double> result;
-    vector<int> discrete_path_s = _discrete_planner->pathS();
-    for(int i = 0; i < discrete_path_s.size(); i++) {
-        if(i==0) {
-            result.push_back(_s);
-        } else {
-            result.push_back(convert_s_to_continuous(discrete_path_s[i]));
-        }
-    }
-    return result;
+chrono::steady_clock::duration TrajectoryPlanner::calculateUntil(chrono::steady_clock::time_point deadline,
+                                                                 chrono::steady_clock::duration slack) {
+    _plan_valid = false;
+    return _discrete_planner->calculateUntil(deadline, slack);
 }
 
-vector<double> TrajectoryPlanner::pathD() {
-    vector<double> result;
-    vector<int> discrete_path_d = _discrete_planner->pathD();
+const TrajectoryPlanner::Plan &TrajectoryPlanner::plan() {
+    if(_plan_valid) {
+        return _plan;
+    }
+    const DiscreteTrajectoryPlanner::Plan &discrete = _discrete_planner->plan();
+    _plan.s.clear();
+    _plan.d.clear();
+    _plan.v.clear();
+    // The start is kept continuous, so the trajectory begins exactly where the car will be.
     cout << "Plan:  " << _d;
-    for(int i = 0; i < discrete_path_d.size(); i++) {
+    for(int i = 0; i < int(discrete.s.size()); i++) {
         if(i==0) {
-            result.push_back(_d);
+            _plan.s.push_back(_s);
+            _plan.d.push_back(_d);
+            _plan.v.push_back(_vs);
         } else {
-            result.push_back(convert_d_to_continuous(discrete_path_d[i]));
+            _plan.s.push_back(convert_s_to_continuous(discrete.s[i]));
+            _plan.d.push_back(convert_d_to_continuous(discrete.d[i]));
+            _plan.v.push_back(convert_v_to_continuous(discrete.v[i]));
         }
-        cout << "   " << discrete_path_d[i];
+        cout << "   " << discrete.d[i];
     }
     cout << endl;
-    return result;
+    _plan.score = discrete.score;
+    _plan.finished = discrete.finished;
+    _plan.expanded = discrete.expanded;
+    _plan.generated = discrete.generated;
+    _plan_valid = true;
+    return _plan;
 }
 
-vector<double> TrajectoryPlanner::pathV() {
-    vector<double> result;
-    vector<int> discrete_path_v = _discrete_planner->pathV();
-    for(int i = 0; i < discrete_path_v.size(); i++) {
-        if(i==0) {
-            result.push_back(_vs);
-        } else {
-            result.push_back(convert_v_to_continuous(discrete_path_v[i]));
-        }
-    }
-    return result;
+const vector<double> &TrajectoryPlanner::pathS() {
+    return plan().s;
+}
+
+const vector<double> &TrajectoryPlanner::pathD() {
+    return plan().d;
+}
+
+const vector<double> &TrajectoryPlanner::pathV() {
+    return plan().v;
 }
 
 int TrajectoryPlanner::convert_s_to_discrete(double s) {
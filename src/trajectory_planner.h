@@ -4,20 +4,38 @@
 #include <unordered_map>
 #include <set>
 #include <queue>
+#include <chrono>
 #include "discrete_trajectory_planner.h"
 
 using namespace std;
 
 class TrajectoryPlanner {
 public:
+    // Result of the search so far, in continuous s, d and speed. Element 0 is the start.
+    struct Plan {
+        vector<double> s, d, v;
+        double score;
+        bool finished;
+        size_t expanded, generated; // States expanded and generated by the search.
+    };
     TrajectoryPlanner(double s, double d, double vs, double vd,
                       vector<double> other_s, vector<double> other_d, vector<double> other_vs, vector<double> other_vd,
                       double max_vs, double max_as, double lookahead_seconds);
     ~TrajectoryPlanner();
+    // Plans again from a new ego state and new sensor data with the same limits, reusing the
+    // search storage and seeding the search with the previous plan. See DiscreteTrajectoryPlanner::replan.
+    void replan(double s, double d, double vs, double vd,
+                vector<double> other_s, vector<double> other_d, vector<double> other_vs, vector<double> other_vd);
+    void setThreads(int threads); // Parallel search. See AStar::setThreads.
     void calculate(double calc_time_limit_seconds);
-    vector<double> pathS();
-    vector<double> pathD();
-    vector<double> pathV();
+    // Searches until deadline, less slack. Returns the overshoot past deadline (negative if early).
+    chrono::steady_clock::duration calculateUntil(chrono::steady_clock::time_point deadline,
+                                                  chrono::steady_clock::duration slack = chrono::microseconds(200));
+    // Built once per search, the first time it is asked for.
+    const Plan &plan();
+    const vector<double> &pathS();
+    const vector<double> &pathD();
+    const vector<double> &pathV();
 private:
     double _lane_width = 4;
     int _num_lanes = 3;
@@ -26,6 +44,8 @@ private:
     double _max_vs, _max_as, _lookahead_seconds;
     int _discrete_max_v;
     DiscreteTrajectoryPlanner* _discrete_planner;
+    Plan _plan;
+    bool _plan_valid; // False once the search has moved on since _plan was built.
     int convert_s_to_discrete(double s);
     int convert_d_to_discrete(double d, double vd);
     int convert_v_to_discrete(double vs);
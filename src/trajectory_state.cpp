@@ -7,7 +7,7 @@ TrajectoryState::TrajectoryState(int s, int d, int v, int t, int simulate_steps,
                                  int min_v, int max_v, int max_a, double penalty_so_far, int num_lanes,
                                  DiscretePrediction* p)
 : _s(s), _d(d), _v(v), _t(t), _simulate_steps(simulate_steps), _horizon_steps(horizon_steps),
-  _min_v(min_v), _max_v(max_v), _max_a(max_a), _penalty_so_far(penalty_so_far), _num_lanes(num_lanes), _p(p)
+  _min_v(min_v), _max_v(max_v), _max_a(max_a), _num_lanes(num_lanes), _penalty_so_far(penalty_so_far), _p(p)
 {
     if(p->crashed(s,d,t)) {
         _penalty_so_far += (simulate_steps + horizon_steps) * 1000;
@@ -34,7 +34,7 @@ TrajectoryState::TrajectoryState(const TrajectoryState &state)
 : _s(state._s), _d(state._d), _v(state._v), _t(state._t),
   _simulate_steps(state._simulate_steps), _horizon_steps(state._horizon_steps),
   _min_v(state._min_v), _max_v(state._max_v), _max_a(state._max_a),
-  _penalty_so_far(state._penalty_so_far), _num_lanes(state._num_lanes), _p(state._p)
+  _num_lanes(state._num_lanes), _penalty_so_far(state._penalty_so_far), _p(state._p)
 {
     _valid = true;
 }
@@ -75,52 +75,32 @@ double TrajectoryState::scoreEstimate() const {
     return _s + optimistic_distance_remaining - _penalty_so_far;
 }
 
-vector<TrajectoryState> TrajectoryState::nextStates() const {
-    vector<TrajectoryState> res;
+double TrajectoryState::scoreSoFar() const {
     if(!_valid) {
-        throw "Called nextStates on invalid TrajectoryState";
-    }
-    if(final()) {
-        return res;
-    }
-    // Can move left or right if and only if that would keep the car on the road.
-    for(int vd = -1; vd <= 1; vd += 2) {
-        int d = _d + vd;
-        if(d >= 0 && d <= 2*(_num_lanes-1)) {
-            TrajectoryState newState(_s + _v, d, _v, _t + 1, _simulate_steps - 1,
-                                     _horizon_steps, _min_v, _max_v, _max_a, _penalty_so_far, _num_lanes, _p);
-            res.push_back(newState);
-        }
-    }
-    // Can only accelerate/decelerate if not already in the middle of a lane change.
-    if(_d % 2 == 0) {
-        for (int a = -_max_a; a <= _max_a; a++) {
-            int v = _v + a;
-            int v_ave = (_v + v) / 2;
-            if (v >= _min_v && v <= _max_v) {
-                TrajectoryState newState(_s+v_ave,_d,_v+a,_t+1,_simulate_steps-1,
-                                         _horizon_steps,_min_v,_max_v,_max_a,_penalty_so_far,_num_lanes,_p);
-                res.push_back(newState);
-            }
-        }
+        return 0.0;
     }
-    return res;
+    return _s - _penalty_so_far;
 }
 
-string TrajectoryState::key() const {
-    ostringstream stream;
-    stream << "<TrjState |" << " s:" << _s << " d:" << _d << " v:" << _v << " t:" << _t << " penalty:" << int(_penalty_so_far) << " >";
-    return stream.str();
+// Packs s, v (two's complement), d, t and whole penalty into 16, 8, 4, 7 and 29 bits.
+// s and v only need to be unique within one search, which covers far less than 2^16 m of s.
+// t stays below 128 (the planner checks simulate_steps + horizon_steps), at most 8 lanes, and
+// each state adds at most 128*1000 + 2 penalty, so the penalty stays below 2^25.
+uint64_t TrajectoryState::key() const {
+    uint64_t penalty = uint64_t(int(_penalty_so_far));
+    return (uint64_t(uint32_t(_s)) & 0xFFFF)
+           | (uint64_t(uint32_t(_v)) & 0xFF) << 16
+           | (uint64_t(_d) & 0xF) << 24
+           | (uint64_t(_t) & 0x7F) << 28
+           | (penalty & 0x1FFFFFFF) << 35;
 }
 
 string TrajectoryState::show() const{
-    return key();
+    ostringstream stream;
+    stream << "<TrjState |" << " s:" << _s << " d:" << _d << " v:" << _v << " t:" << _t << " penalty:" << int(_penalty_so_far) << " >";
+    return stream.str();
 }
 
 bool TrajectoryState::final() const {
     return _simulate_steps == 0;
 }
-
-bool TrajectoryState::operator<(const TrajectoryState& rhs) const {
-    return scoreEstimate() < rhs.scoreEstimate();
-}
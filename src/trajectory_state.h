@@ -1,6 +1,7 @@
 #ifndef PATH_PLANNING_TRAJECTORY_STATE_H
 #define PATH_PLANNING_TRAJECTORY_STATE_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "discrete_prediction.h"
@@ -19,16 +20,47 @@ public:
                     int min_v, int max_v, int max_a, double penalty_so_far, int num_lanes,
                     DiscretePrediction* p);
     TrajectoryState(const TrajectoryState &state);
+    TrajectoryState &operator=(const TrajectoryState &state) = default;
     TrajectoryState(); // Default is not valid. Exists because some containers require it.
     int s();
     int d();
     int v();
     double scoreEstimate() const; // Higher is better. Must be greater than or equal to true score.
-    vector<TrajectoryState> nextStates() const;
-    string key() const; // Must be unique. Used to determine if we've seen this state before.
+    double scoreSoFar() const; // Score of the path up to this state, without the optimistic remainder.
+    // Calls f(const TrajectoryState &) for each state reachable in one step.
+    template <class F> void forEachSuccessor(F &&f) const;
+    uint64_t key() const; // Must be unique. Used to determine if we've seen this state before.
     string show() const;
     bool final() const; // True if this state is candidate to be the end of a path.
-    bool operator<(const TrajectoryState& rhs) const; // Based on score_estimate, needed for priority_queue
 };
 
+template <class F>
+void TrajectoryState::forEachSuccessor(F &&f) const {
+    if(!_valid) {
+        throw "Called forEachSuccessor on invalid TrajectoryState";
+    }
+    if(final()) {
+        return;
+    }
+    // Can move left or right if and only if that would keep the car on the road.
+    for(int vd = -1; vd <= 1; vd += 2) {
+        int d = _d + vd;
+        if(d >= 0 && d <= 2*(_num_lanes-1)) {
+            f(TrajectoryState(_s + _v, d, _v, _t + 1, _simulate_steps - 1,
+                              _horizon_steps, _min_v, _max_v, _max_a, _penalty_so_far, _num_lanes, _p));
+        }
+    }
+    // Can only accelerate/decelerate if not already in the middle of a lane change.
+    if(_d % 2 == 0) {
+        for (int a = -_max_a; a <= _max_a; a++) {
+            int v = _v + a;
+            int v_ave = (_v + v) / 2;
+            if (v >= _min_v && v <= _max_v) {
+                f(TrajectoryState(_s+v_ave,_d,_v+a,_t+1,_simulate_steps-1,
+                                  _horizon_steps,_min_v,_max_v,_max_a,_penalty_so_far,_num_lanes,_p));
+            }
+        }
+    }
+}
+
 #endif
@@ -0,0 +1,50 @@
+#ifndef PATH_PLANNING_TRIPLE_BUFFER_H
+#define PATH_PLANNING_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+using namespace std;
+
+// Latest value passed from exactly one producer thread to one consumer thread, without locks.
+// The producer fills back() then publish()es it, replacing any value the consumer has not taken
+// yet, so it never has to wait and the consumer only ever sees the newest value. Each thread owns
+// one of three slots and the third is swapped between them. Slots keep what was last written to
+// them, so buffers inside T are reused rather than reallocated.
+template<typename T>
+class TripleBuffer {
+private:
+    static const unsigned FRESH = 4; // Set in _middle when it holds a value the consumer has not taken.
+    T _slots[3];
+    alignas(64) atomic<unsigned> _middle; // Slot between the threads, plus FRESH.
+    alignas(64) unsigned _back;           // Producer's slot.
+    alignas(64) unsigned _front;          // Consumer's slot.
+public:
+    TripleBuffer() : _middle(1), _back(0), _front(2) {}
+
+    // Producer only. Slot for the next value.
+    T &back() {
+        return _slots[_back];
+    }
+
+    // Producer only. Hands the value in back() to the consumer, in place of any not yet taken.
+    void publish() {
+        _back = _middle.exchange(_back | FRESH) & ~FRESH;
+    }
+
+    // Consumer only. Whether a value has been published since the last take().
+    bool fresh() const {
+        return (_middle.load() & FRESH) != 0;
+    }
+
+    // Consumer only. Newest value published since the last take(), or nullptr. The value stays valid
+    // until the next take().
+    T *take() {
+        if(!fresh()) {
+            return nullptr;
+        }
+        _front = _middle.exchange(_front) & ~FRESH;
+        return &_slots[_front];
+    }
+};
+
+#endif
@@ -1,8 +1,67 @@
 #include "gtest/gtest.h"
+#include <string>
+#include <vector>
+#include "../src/astar.h"
 
 namespace {
 
     TEST(AStarTest, Equality) {
         EXPECT_EQ(1,1);
     }
+
+    /*
+       Small graph where a weighted pass closes K through the worse of its two paths, then prunes
+       everything left against a seeded path S-D-E-T2 and runs out of open states:
+                 B(0) - K(0) -
+          S  <               >- T(+2)      T is 2 via B, 3 via Y
+                 Y(-4) - K(+5)
+                 D(+2.5) - E(0) - T2(0)    T2 is 2.5
+       Numbers are rewards for entering a node. The heuristic is admissible but favours B over Y.
+     */
+    enum Node { S, B, Y, D, K, E, T, T2, NUM_NODES };
+
+    struct GraphState {
+        int node;
+        double g;
+        double heuristic() const {
+            static const double h[NUM_NODES] = {10, 8, 14, 0, 8, 0, 0, 0};
+            return h[node];
+        }
+        double scoreEstimate() const { return g + heuristic(); }
+        double scoreSoFar() const { return g; }
+        template<class F>
+        void forEachSuccessor(F &&f) const {
+            struct Edge { int from, to; double reward; };
+            static const Edge edges[] = {{S, B, 0}, {S, Y, -4}, {S, D, 2.5}, {B, K, 0}, {Y, K, 5},
+                                         {K, T, 2}, {D, E, 0}, {E, T2, 0}};
+            for(const Edge &edge : edges) {
+                if(edge.from == node) {
+                    f(GraphState{edge.to, g + edge.reward});
+                }
+            }
+        }
+        int key() const { return node; }
+        string show() const { return to_string(node) + ":" + to_string(g); }
+        bool final() const { return node == T || node == T2; }
+    };
+
+    TEST(AStarTest, PlainFindsBest) {
+        AStar<GraphState> search(GraphState{S, 0});
+        search.calculateSteps(100);
+        EXPECT_TRUE(search.finished());
+        EXPECT_EQ(search.score(), 3);
+    }
+
+    // A weighted pass that exhausts its open list proves nothing; the weight 1 pass must still run.
+    TEST(AStarTest, ExhaustedWeightedPass) {
+        AStar<GraphState> search(GraphState{S, 0});
+        search.setAnytimeWeights({2.0});
+        ASSERT_TRUE(search.seedPath({GraphState{S, 0}, GraphState{D, 2.5}, GraphState{E, 2.5}, GraphState{T2, 2.5}}));
+        search.calculateSteps(100);
+        EXPECT_TRUE(search.finished());
+        EXPECT_EQ(search.score(), 3);
+        vector<GraphState> path = search.path();
+        ASSERT_EQ(path.size(), 4);
+        EXPECT_EQ(path[1].node, Y);
+    }
 }
@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include "../src/json.hpp"
+#include "../src/control_message.h"
+
+namespace {
+
+    string jsonNumber(double value) {
+        return nlohmann::json(value).dump();
+    }
+
+    string formatNumber(double value) {
+        char out[ControlMessageWriter::NUMBER_CHARS];
+        size_t n = ControlMessageWriter::formatNumber(value, out);
+        EXPECT_EQ(n, strlen(out));
+        return string(out, n);
+    }
+
+    // Every number must come out as the json library wrote it before.
+    TEST(ControlMessageTest, MatchesJsonNumbers) {
+        for(double value : {0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 2.5, 1e-4, 9.99999999999999e-5, 1e-5, 123.456,
+                            909.48, 1128.67, 6945.554, -277.6, 1e14, 1e15, 999999999999999.0,
+                            999999999999999.9, 0.30000000000000004, 1.0 / 3, 2.0 / 3, 1e300, -1e-300,
+                            1234567.0, 0.000123456789012345678}) {
+            EXPECT_EQ(formatNumber(value), jsonNumber(value)) << value;
+        }
+        srand(3);
+        for(int i = 0; i < 200000; i++) {
+            // Random digits across all the magnitudes the fast path covers, and a few beyond.
+            double value = (double(rand()) / RAND_MAX) * pow(10.0, rand() % 24 - 6);
+            if(i % 2 == 1) {
+                value = -value;
+            }
+            if(i % 5 == 0) {
+                value = round(value * 100) / 100; // Short decimals like the ones on the track.
+            }
+            ASSERT_EQ(formatNumber(value), jsonNumber(value)) << value;
+        }
+    }
+
+    TEST(ControlMessageTest, MatchesJsonMessage) {
+        vector<double> x = {909.48, 909.5, 910.0}, y = {1128.67, 1128.7, -0.25};
+        nlohmann::json msgJson;
+        msgJson["next_x"] = x;
+        msgJson["next_y"] = y;
+        ControlMessageWriter writer;
+        EXPECT_EQ(writer.write(x, y), "42[\"control\"," + msgJson.dump() + "]");
+
+        nlohmann::json emptyJson;
+        emptyJson["next_x"] = vector<double>();
+        emptyJson["next_y"] = vector<double>();
+        EXPECT_EQ(writer.write({}, {}), "42[\"control\"," + emptyJson.dump() + "]");
+    }
+
+    // Writing a message no longer than the last must reuse the buffer.
+    TEST(ControlMessageTest, ReusesBuffer) {
+        vector<double> x(150, 1000.123), y(150, 2000.456);
+        ControlMessageWriter writer;
+        const char *buffer = writer.write(x, y).data();
+        x.assign(150, 1.5);
+        EXPECT_EQ(writer.write(x, y).data(), buffer);
+    }
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include "../src/discrete_prediction.h"
+
+namespace {
+
+    // Straightforward scan over all cars, as the queries were originally written.
+    struct Car {
+        int s, d, v;
+    };
+
+    vector<Car> carsAt(const vector<Car> &cars, int t) {
+        vector<Car> result;
+        for(const Car &car : cars) {
+            int s = car.s + t * car.v;
+            if(car.d % 2 == 1 && t >= 2) {
+                // Car on lane line will be in one of the lanes next to it.
+                result.push_back({s, car.d - 1, car.v});
+                result.push_back({s, car.d + 1, car.v});
+            } else {
+                result.push_back({s, car.d, car.v});
+            }
+        }
+        return result;
+    }
+
+    bool tooClose(const vector<Car> &cars, int s, int d, int preferred_distance) {
+        for(const Car &car : cars) {
+            if(s < car.s + preferred_distance && s > car.s - preferred_distance && d <= car.d + 1 && d >= car.d - 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool crashed(const vector<Car> &cars, int s, int d, int crash_distance) {
+        for(const Car &car : cars) {
+            if(s <= car.s + crash_distance && s >= car.s - crash_distance && d == car.d) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int spaceAhead(const vector<Car> &cars, int s, int d, int horizon, int preferred_distance) {
+        int min_dist = horizon;
+        for(const Car &car : cars) {
+            if(d <= car.d + 1 && d >= car.d - 1 && s < car.s + preferred_distance) {
+                min_dist = min(car.s - s - preferred_distance, min_dist);
+                if(min_dist <= 0) {
+                    return 0;
+                }
+            }
+        }
+        return min_dist;
+    }
+
+    // Checks every query against the scan, optionally with the bitmaps covering only part of the s range.
+    void expectMatchesScan(bool raster) {
+        srand(7);
+        for(int trial = 0; trial < 20; trial++) {
+            int num_cars = trial % 15;
+            vector<Car> cars;
+            vector<int> cars_s, cars_d, cars_v;
+            for(int i = 0; i < num_cars; i++) {
+                cars.push_back({rand() % 80, rand() % 5, rand() % 7 - 3});
+                cars_s.push_back(cars.back().s);
+                cars_d.push_back(cars.back().d);
+                cars_v.push_back(cars.back().v);
+            }
+            int crash_distance = 1 + trial % 3, preferred_distance = 3 + trial % 8;
+            DiscretePrediction prediction(cars_s, cars_d, cars_v, crash_distance, preferred_distance);
+            if(raster) {
+                // Rasterize part way through predicting, so both rasterize() and predict() fill bitmaps.
+                // Some trials leave the rightmost lanes out, which must fall back to the sorted arrays.
+                prediction.predict(3);
+                prediction.rasterize(-10 + trial, 90 + 3 * trial, trial % 3 == 0 ? 2 : 4);
+            }
+            for(int t = 0; t <= 6; t++) {
+                vector<Car> cars_t = carsAt(cars, t);
+                for(int d = 0; d <= 4; d++) {
+                    for(int s = -30; s < 120; s++) {
+                        EXPECT_EQ(prediction.tooClose(s, d, t), tooClose(cars_t, s, d, preferred_distance));
+                        EXPECT_EQ(prediction.crashed(s, d, t), crashed(cars_t, s, d, crash_distance));
+                        for(int horizon : {-5, 0, 20, 200}) {
+                            EXPECT_EQ(prediction.spaceAhead(s, d, t, horizon),
+                                      spaceAhead(cars_t, s, d, horizon, preferred_distance));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    TEST(DiscretePredictionTest, MatchesScan) {
+        expectMatchesScan(false);
+    }
+
+    TEST(DiscretePredictionTest, RasterMatchesScan) {
+        expectMatchesScan(true);
+    }
+
+    /*
+       Two cars in the center lane and one on the left lane line.
+       ------------------------------------
+                      1
+       ---------------1--------------------
+                 X    1       X
+       ------------------------------------
+     */
+    TEST(DiscretePredictionTest, Lanes) {
+        DiscretePrediction prediction({10, 30, 15}, {2, 2, 1}, {0, 0, 1}, 1, 3);
+        EXPECT_TRUE(prediction.crashed(9, 2, 0));
+        EXPECT_TRUE(prediction.crashed(31, 2, 0));
+        EXPECT_FALSE(prediction.crashed(12, 2, 0));
+        EXPECT_FALSE(prediction.crashed(10, 4, 0));
+        EXPECT_TRUE(prediction.tooClose(12, 2, 0));
+        EXPECT_FALSE(prediction.tooClose(13, 3, 0));
+        EXPECT_TRUE(prediction.tooClose(13, 0, 0)); // Next to the car on the lane line.
+        EXPECT_EQ(prediction.spaceAhead(20, 3, 0, 100), 7);
+        EXPECT_EQ(prediction.spaceAhead(20, 0, 0, 100), 100);
+        // By t=2 the lane line car is considered to be in both lanes next to it.
+        EXPECT_TRUE(prediction.crashed(17, 0, 2));
+        EXPECT_TRUE(prediction.crashed(17, 2, 2));
+        EXPECT_FALSE(prediction.crashed(17, 1, 2));
+        EXPECT_EQ(prediction.spaceAhead(0, 0, 2, 100), 14);
+    }
+}
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
+#include <cmath>
 #include "../src/discrete_trajectory_planner.h"
+#include "../src/trajectory_state.h"
 
 namespace {
 
@@ -130,4 +132,219 @@ namespace {
         EXPECT_EQ(planner.pathD(),expected_path_d);
         EXPECT_EQ(planner.pathV(),expected_path_v);
     }
+
+    // A search whose deadline has already passed must not run at all. One with a deadline must
+    // finish, or run until deadline - slack and stop soon after. "Soon" is checked against the
+    // budget, not a fixed time, so a loaded machine or a sanitizer build does not fail the test.
+    TEST(DiscreteTrajectoryTest, Deadline) {
+        int ego_s=0, ego_d=2, ego_v=0;
+        int simulate_steps=60, horizon_steps=10;
+        int max_v=30, max_a=3, num_lanes=3;
+        int crash_distance=3, preferred_distance=10;
+        vector<int>
+                other_s = {40,60,90,120,150},
+                other_d = {0,2,4,2,0},
+                other_v = {10,12,8,11,9};
+        DiscreteTrajectoryPlanner planner(ego_s, ego_d, ego_v,
+                                          other_s, other_d, other_v,
+                                          simulate_steps, horizon_steps,
+                                          max_v, max_a, num_lanes,
+                                          crash_distance, preferred_distance);
+        chrono::steady_clock::duration overshoot =
+                planner.calculateUntil(chrono::steady_clock::now() - chrono::milliseconds(1), chrono::microseconds(0));
+        EXPECT_FALSE(planner.finished());
+        EXPECT_LE(planner.pathS().size(), 1);
+        EXPECT_GE(overshoot, chrono::milliseconds(1));
+        chrono::steady_clock::duration budget = chrono::milliseconds(20), slack = chrono::microseconds(500);
+        chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + budget;
+        overshoot = planner.calculateUntil(deadline, slack);
+        chrono::steady_clock::time_point returned = chrono::steady_clock::now();
+        EXPECT_GT(planner.pathS().size(), 1);
+        EXPECT_LE(deadline + overshoot, returned);
+        if(!planner.finished()) {
+            EXPECT_GE(overshoot, -slack);
+        }
+        EXPECT_LT(overshoot, budget);
+    }
+
+    // Anytime search must end at the same path as plain A*, improving monotonically on the way.
+    TEST(DiscreteTrajectoryTest, Anytime) {
+        int ego_s=0, ego_d=0, ego_v =0;
+        int simulate_steps=10, horizon_steps=5;
+        int max_v=3, max_a=1, num_lanes=3;
+        int crash_distance=1, preferred_distance=3;
+        vector<int>
+                other_s = {17,15,21},
+                other_d = {0,2,4},
+                other_v = {0,0,0};
+        DiscreteTrajectoryPlanner planner(ego_s, ego_d, ego_v,
+                                          other_s, other_d, other_v,
+                                          simulate_steps, horizon_steps,
+                                          max_v, max_a, num_lanes,
+                                          crash_distance, preferred_distance);
+        vector<double> scores, bounds;
+        planner.setAnytime({5.0, 2.0, 1.2}, [&scores, &bounds](double score, double bound) {
+            scores.push_back(score);
+            bounds.push_back(bound);
+        });
+        planner.calculateSeconds(1.0);
+        EXPECT_TRUE(planner.finished());
+        EXPECT_EQ(planner.bound(), 0.0);
+        ASSERT_FALSE(scores.empty());
+        for(int i = 0; i < int(scores.size()); i++) {
+            EXPECT_GE(bounds[i], 0.0);
+            if(i > 0) {
+                EXPECT_GT(scores[i], scores[i-1]);
+            }
+        }
+        EXPECT_EQ(scores.back(), planner.score());
+        vector<int> expected_path_s = {0,0,1,3,6,9,12,15,18,21,24};
+        vector<int> expected_path_d = {0,0,0,0,1,2,3,4,3,2,2};
+        vector<int> expected_path_v = {0,1,2,3,3,3,3,3,3,3,3};
+        EXPECT_EQ(planner.pathS(),expected_path_s);
+        EXPECT_EQ(planner.pathD(),expected_path_d);
+        EXPECT_EQ(planner.pathV(),expected_path_v);
+    }
+
+    // A large weight should reach a full-length path in far fewer steps than plain A*.
+    TEST(DiscreteTrajectoryTest, AnytimeFindsFullPathEarly) {
+        int ego_s=0, ego_d=2, ego_v=0;
+        int simulate_steps=60, horizon_steps=10;
+        int max_v=30, max_a=3, num_lanes=3;
+        int crash_distance=3, preferred_distance=10;
+        vector<int>
+                other_s = {40,60,90,120,150},
+                other_d = {0,2,4,2,0},
+                other_v = {10,12,8,11,9};
+        DiscreteTrajectoryPlanner planner(ego_s, ego_d, ego_v,
+                                          other_s, other_d, other_v,
+                                          simulate_steps, horizon_steps,
+                                          max_v, max_a, num_lanes,
+                                          crash_distance, preferred_distance);
+        int improvements = 0;
+        planner.setAnytime({10.0, 3.0, 1.5}, [&improvements](double, double) { improvements++; });
+        EXPECT_TRUE(std::isinf(planner.bound()));
+        planner.calculateSteps(200);
+        EXPECT_GE(improvements, 1);
+        EXPECT_EQ(planner.pathS().size(), simulate_steps + 1);
+        EXPECT_FALSE(std::isinf(planner.bound()));
+    }
+
+    // Replanning one step further along must seed the search with the previous plan and
+    // end at the same path as a planner built from scratch.
+    TEST(DiscreteTrajectoryTest, Replan) {
+        int simulate_steps=10, horizon_steps=5;
+        int max_v=3, max_a=1, num_lanes=3;
+        int crash_distance=1, preferred_distance=3;
+        vector<int>
+                other_s = {17,15,21},
+                other_d = {0,2,4},
+                other_v = {0,0,0};
+        DiscreteTrajectoryPlanner planner(0, 0, 0,
+                                          other_s, other_d, other_v,
+                                          simulate_steps, horizon_steps,
+                                          max_v, max_a, num_lanes,
+                                          crash_distance, preferred_distance);
+        planner.setAnytime({5.0, 2.0});
+        planner.calculateSeconds(1.0);
+        ASSERT_TRUE(planner.finished());
+        int ego_s = planner.pathS()[1], ego_d = planner.pathD()[1], ego_v = planner.pathV()[1];
+
+        planner.replan(ego_s, ego_d, ego_v, other_s, other_d, other_v);
+        EXPECT_FALSE(planner.finished());
+        EXPECT_EQ(planner.pathS().size(), simulate_steps + 1);
+        EXPECT_FALSE(std::isinf(planner.bound()));
+        planner.calculateSeconds(1.0);
+        EXPECT_TRUE(planner.finished());
+
+        DiscreteTrajectoryPlanner fresh(ego_s, ego_d, ego_v,
+                                        other_s, other_d, other_v,
+                                        simulate_steps, horizon_steps,
+                                        max_v, max_a, num_lanes,
+                                        crash_distance, preferred_distance);
+        fresh.calculateSeconds(1.0);
+        EXPECT_TRUE(fresh.finished());
+        EXPECT_EQ(planner.score(), fresh.score());
+        EXPECT_EQ(planner.pathS(), fresh.pathS());
+        EXPECT_EQ(planner.pathD(), fresh.pathD());
+        EXPECT_EQ(planner.pathV(), fresh.pathV());
+    }
+
+    // Parallel search must reach an equally good plan as the serial search on each scenario above.
+    // Paths may differ where several score the same (as in Blocked), so compare score and end state.
+    TEST(DiscreteTrajectoryTest, Parallel) {
+        struct Scenario {
+            int ego_s, ego_d, ego_v, simulate_steps, horizon_steps, max_v, max_a, crash_distance, preferred_distance;
+            vector<int> other_s, other_d, other_v;
+        };
+        vector<Scenario> scenarios = {
+                {0, 2, 0, 5, 5, 3, 1, 1, 3, {}, {}, {}},
+                {0, 2, 0, 5, 5, 3, 1, 1, 3, {5,5}, {0,4}, {0,0}},
+                {0, 2, 0, 9, 5, 3, 1, 1, 3, {15,15,15}, {0,2,4}, {0,0,0}},
+                {0, 0, 0, 10, 5, 3, 1, 1, 3, {17,15,21}, {0,2,4}, {0,0,0}},
+                {0, 2, 0, 20, 10, 8, 1, 2, 6, {17,15,21,40,45,60}, {0,2,4,2,0,4}, {0,0,0,1,1,1}},
+        };
+        int num_lanes = 3;
+        for(const Scenario &c : scenarios) {
+            DiscreteTrajectoryPlanner serial(c.ego_s, c.ego_d, c.ego_v, c.other_s, c.other_d, c.other_v,
+                                             c.simulate_steps, c.horizon_steps, c.max_v, c.max_a, num_lanes,
+                                             c.crash_distance, c.preferred_distance);
+            serial.calculateSeconds(10.0);
+            ASSERT_TRUE(serial.finished());
+            for(int threads : {2, 4}) {
+                DiscreteTrajectoryPlanner parallel(c.ego_s, c.ego_d, c.ego_v, c.other_s, c.other_d, c.other_v,
+                                                   c.simulate_steps, c.horizon_steps, c.max_v, c.max_a, num_lanes,
+                                                   c.crash_distance, c.preferred_distance);
+                parallel.setThreads(threads);
+                parallel.calculateSeconds(10.0);
+                EXPECT_TRUE(parallel.finished());
+                EXPECT_EQ(parallel.score(), serial.score());
+                ASSERT_EQ(parallel.pathS().size(), serial.pathS().size());
+                EXPECT_EQ(parallel.pathS().back(), serial.pathS().back());
+                EXPECT_EQ(parallel.pathD().back(), serial.pathD().back());
+            }
+        }
+    }
+
+    // The plan is built once per search and handed out by reference until the search moves on.
+    TEST(DiscreteTrajectoryTest, Plan) {
+        DiscreteTrajectoryPlanner planner(0, 2, 0, {}, {}, {}, 5, 5, 3, 1, 3, 1, 3);
+        planner.calculateSteps(2);
+        const DiscreteTrajectoryPlanner::Plan &partial = planner.plan();
+        EXPECT_FALSE(partial.finished);
+        EXPECT_EQ(partial.expanded, 2);
+        EXPECT_GT(partial.generated, partial.expanded);
+        planner.calculateSeconds(1.0);
+        const DiscreteTrajectoryPlanner::Plan &plan = planner.plan();
+        EXPECT_TRUE(plan.finished);
+        EXPECT_EQ(plan.score, planner.score());
+        EXPECT_EQ(&planner.pathS(), &plan.s);
+        EXPECT_EQ(&planner.pathD(), &plan.d);
+        EXPECT_EQ(&planner.pathV(), &plan.v);
+        vector<int> expected_path_s = {0,0,1,3,6,9};
+        vector<int> expected_path_d = {2,2,2,2,2,2};
+        vector<int> expected_path_v = {0,1,2,3,3,3};
+        EXPECT_EQ(plan.s,expected_path_s);
+        EXPECT_EQ(plan.d,expected_path_d);
+        EXPECT_EQ(plan.v,expected_path_v);
+    }
+
+    // A long search with crashes piles up more penalty than fits in 20 bits, and states that differ
+    // only in penalty must still have different keys.
+    TEST(DiscreteTrajectoryTest, KeyKeepsLargePenalties) {
+        DiscretePrediction prediction({}, {}, {}, 1, 3);
+        int simulate_steps = 60, horizon_steps = 60;
+        TrajectoryState low(-20, 4, -3, 119, simulate_steps, horizon_steps, -3, 3, 1, 5.0, 3, &prediction);
+        TrajectoryState high(-20, 4, -3, 119, simulate_steps, horizon_steps, -3, 3, 1, 5.0 + (1 << 20), 3, &prediction);
+        TrajectoryState highest(-20, 4, -3, 119, simulate_steps, horizon_steps, -3, 3, 1,
+                                120.0 * (120 * 1000 + 2), 3, &prediction);
+        EXPECT_NE(low.key(), high.key());
+        EXPECT_NE(high.key(), highest.key());
+        EXPECT_NE(low.key(), highest.key());
+        EXPECT_EQ(highest.key() >> 35, uint64_t(120 * (120 * 1000 + 2)));
+    }
+
+    TEST(DiscreteTrajectoryTest, TooManySteps) {
+        EXPECT_ANY_THROW(DiscreteTrajectoryPlanner(0, 2, 0, {}, {}, {}, 100, 28, 3, 1, 3, 1, 3));
+    }
 }
@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../src/session.h"
+
+namespace {
+
+    // Tests are run from the build directory, like the path_planning executable.
+    const string map_file = "../data/highway_map.csv";
+
+    const string message =
+            "42[\"telemetry\",{\"x\":909.48,\"y\":1128.67,\"yaw\":0,\"speed\":0,\"s\":124.8336,\"d\":6.164833,"
+            "\"previous_path_x\":[],\"previous_path_y\":[],\"end_path_s\":0,\"end_path_d\":0,"
+            "\"sensor_fusion\":[[0,1021.654,1147.212,12.4,0.5,235.5,2.036]]}]";
+
+    // Several sessions share one Track and one pool, and each gets a reply to every frame it waits for.
+    TEST(SessionTest, Replies) {
+        ThreadPool pool(2);
+        shared_ptr<const Track> track = make_shared<const Track>(map_file);
+        mutex m;
+        condition_variable replied;
+        int replies = 0;
+        function<void()> onReply = [&] {
+            lock_guard<mutex> lock(m);
+            replies++;
+            replied.notify_one();
+        };
+        vector<shared_ptr<Session>> sessions;
+        for(int i = 0; i < 3; i++) {
+            sessions.push_back(make_shared<Session>(track, pool, 21, 9.5, onReply));
+        }
+        for(int round = 1; round <= 2; round++) {
+            for(shared_ptr<Session> &session : sessions) {
+                Session::Frame &frame = session->frame();
+                ASSERT_EQ(frame.telemetry.parse(message.data(), message.size()), Telemetry::DATA);
+                frame.arrival = chrono::steady_clock::now();
+                session->submitFrame();
+            }
+            {
+                unique_lock<mutex> lock(m);
+                replied.wait(lock, [&] { return replies == round * int(sessions.size()); });
+            }
+            for(shared_ptr<Session> &session : sessions) {
+                Session::Reply *reply = session->reply();
+                ASSERT_NE(reply, nullptr);
+                EXPECT_EQ(reply->message.find("42[\"control\",{\"next_x\":["), 0);
+                session->releaseReply();
+                EXPECT_EQ(session->reply(), nullptr);
+                EXPECT_EQ(session->stats().frames_planned, round);
+                EXPECT_LE(session->stats().deadlines_missed, round);
+                EXPECT_EQ(session->stats().frames_dropped, 0);
+            }
+        }
+    }
+
+    // With every reply slot waiting to be sent, further frames are counted as dropped.
+    TEST(SessionTest, DropsWhenRepliesUnsent) {
+        ThreadPool pool(1);
+        shared_ptr<const Track> track = make_shared<const Track>(map_file);
+        mutex m;
+        condition_variable replied;
+        int replies = 0;
+        shared_ptr<Session> session = make_shared<Session>(track, pool, 21, 9.5, [&] {
+            lock_guard<mutex> lock(m);
+            replies++;
+            replied.notify_one();
+        });
+        for(int i = 1; i <= 5; i++) {
+            Session::Frame &frame = session->frame();
+            ASSERT_EQ(frame.telemetry.parse(message.data(), message.size()), Telemetry::DATA);
+            frame.arrival = chrono::steady_clock::now();
+            session->submitFrame();
+            // Wait for each frame to be planned or dropped, so none replaces another.
+            while(session->stats().frames_planned + session->stats().frames_dropped < unsigned(i)) {
+                this_thread::yield();
+            }
+        }
+        EXPECT_EQ(session->stats().frames_planned, 4);
+        EXPECT_EQ(session->stats().frames_dropped, 1);
+        unique_lock<mutex> lock(m);
+        replied.wait(lock, [&] { return replies == 4; });
+    }
+}
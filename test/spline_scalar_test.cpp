@@ -0,0 +1,26 @@
+#include "gtest/gtest.h"
+#include <vector>
+// Build this file's copy of the spline with the scalar kernels, whatever the target supports.
+#define TK_SPLINE_NO_SIMD
+#include "../src/spline.h"
+
+using namespace std;
+
+namespace {
+
+    TEST(SplineScalarTest, EvalSortedMatchesPointwise) {
+        vector<double> x = {0.0, 1.0, 2.5, 4.0, 4.5, 7.0}, y = {1.0, 3.0, -2.0, 0.5, 0.25, 4.0};
+        tk::spline s;
+        s.set_points(x, y);
+        for(size_t n : {1, 3, 4, 5, 7}) {
+            vector<double> xs, ys(n);
+            for(size_t i = 0; i < n; i++) {
+                xs.push_back(n == 1 ? -1.5 : -1.5 + 10.0 * i / (n - 1));
+            }
+            s.eval_sorted(xs.data(), ys.data(), n);
+            for(size_t i = 0; i < n; i++) {
+                EXPECT_NEAR(ys[i], s(xs[i]), 1e-9) << "x=" << xs[i] << " n=" << n;
+            }
+        }
+    }
+}
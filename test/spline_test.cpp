@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <vector>
+#include "../src/spline.h"
+
+using namespace std;
+
+namespace {
+
+    const vector<double> knots_x = {0.0, 1.0, 2.5, 4.0, 4.5, 7.0};
+    const vector<double> knots_y = {1.0, 3.0, -2.0, 0.5, 0.25, 4.0};
+
+    // n evenly spaced points from 1.5 before the first knot to 1.5 after the last.
+    vector<double> queries(size_t n) {
+        vector<double> xs;
+        double from = knots_x.front() - 1.5, to = knots_x.back() + 1.5;
+        for(size_t i = 0; i < n; i++) {
+            xs.push_back(n == 1 ? from : from + (to - from) * i / (n - 1));
+        }
+        return xs;
+    }
+
+    void expectEvalSortedMatches(const tk::spline &s, const vector<double> &xs) {
+        vector<double> ys(xs.size());
+        s.eval_sorted(xs.data(), ys.data(), xs.size());
+        for(size_t i = 0; i < xs.size(); i++) {
+            EXPECT_NEAR(ys[i], s(xs[i]), 1e-9) << "x=" << xs[i] << " n=" << xs.size();
+        }
+    }
+
+    // Covers left and right extrapolation, and the points after the last full group of 4.
+    TEST(SplineTest, EvalSortedMatchesPointwise) {
+        tk::spline natural, clamped, linear_ends;
+        natural.set_points(knots_x, knots_y);
+        clamped.set_boundary(tk::spline::first_deriv, 2.0, tk::spline::first_deriv, -1.0);
+        clamped.set_points(knots_x, knots_y);
+        linear_ends.set_boundary(tk::spline::second_deriv, 0.0, tk::spline::second_deriv, 0.0, true);
+        linear_ends.set_points(knots_x, knots_y);
+        for(const tk::spline *s : {&natural, &clamped, &linear_ends}) {
+            for(size_t n : {1, 3, 4, 5, 7, 150}) {
+                expectEvalSortedMatches(*s, queries(n));
+            }
+            expectEvalSortedMatches(*s, {knots_x.back() + 2.0}); // Single point right of the knots.
+            expectEvalSortedMatches(*s, knots_x);                // Exactly on the knots.
+            expectEvalSortedMatches(*s, {5.0, -1.0, 8.0, 2.0, 0.5, 6.0, -0.5}); // Any order is allowed.
+        }
+    }
+
+    /*
+       Values from the original tk::spline, which solved with a general band matrix LU
+       decomposition, at 6 even steps from 1 before the first knot to 1 after the last.
+     */
+    TEST(SplineTest, MatchesBandMatrixSolver) {
+        vector<vector<double>> xs = {{0, 1, 2.5, 4, 4.5, 7}, {-3, -1, 0, 2}, {0, 10, 20, 30, 40, 50, 60, 70}};
+        vector<vector<double>> ys = {{1, 3, -2, 0.5, 0.25, 4}, {2, 0, 1, -1}, {0, 5, 3, 8, 8, 2, -4, 1}};
+        vector<vector<double>> expected = {
+                {-2.5173798203909139, 3.0370053882725832, -2.0669299524564182, 0.32466941362915974, 2.0282441838351835, 6.5747490755414697},
+                {3.7999999999999998, 1.2928000000000002, -0.073599999999999888, 1.0736000000000001, -0.29279999999999973, -2.8000000000000003},
+                {-0.74472689797320513, 4.3929535115080727, 6.8381226080384749, 7.0713977299896928, -2.8849149762968054, 1.7869804190999656}};
+        for(size_t k = 0; k < xs.size(); k++) {
+            tk::spline s;
+            s.set_points(xs[k], ys[k]);
+            double from = xs[k].front() - 1, to = xs[k].back() + 1;
+            for(int i = 0; i < 6; i++) {
+                EXPECT_NEAR(s(from + (to - from) * i / 5), expected[k][i], 1e-12) << "set " << k << " point " << i;
+            }
+        }
+        tk::spline clamped;
+        clamped.set_boundary(tk::spline::first_deriv, 2.0, tk::spline::first_deriv, -1.0);
+        clamped.set_points(xs[0], ys[0]);
+        vector<double> expected_clamped = {1.5618661257606496, 2.9279188640973635, -2.0738880625046954,
+                                           0.30051386071670028, 3.4111264367816103, 0.27924273157538737};
+        for(int i = 0; i < 6; i++) {
+            EXPECT_NEAR(clamped(-1.0 + 9.0 * i / 5), expected_clamped[i], 1e-12) << "clamped point " << i;
+        }
+    }
+
+    // The solution must satisfy the original system, checked row by row.
+    TEST(SplineTest, Tridiagonal) {
+        srand(5);
+        for(int n : {1, 2, 3, 10}) {
+            tk::spline_workspace ws;
+            ws.resize(n);
+            for(int i = 0; i < n; i++) {
+                ws.lower[i] = (i > 0) ? double(rand() % 100) / 100 : 0.0;
+                ws.upper[i] = (i < n - 1) ? double(rand() % 100) / 100 : 0.0;
+                ws.diag[i] = 2.5 + double(rand() % 100) / 100; // Diagonally dominant, like the spline systems.
+                ws.rhs[i] = double(rand() % 200) / 10 - 10;
+            }
+            tk::spline_workspace original = ws;
+            tk::tridiagonal_decompose(ws, n);
+            tk::tridiagonal_solve(ws, n, &ws.rhs[0]);
+            const vector<double> &solution = ws.rhs;
+            for(int i = 0; i < n; i++) {
+                double row = original.diag[i] * solution[i];
+                if(i > 0) {
+                    row += original.lower[i] * solution[i-1];
+                }
+                if(i < n - 1) {
+                    row += original.upper[i] * solution[i+1];
+                }
+                EXPECT_NEAR(row, original.rhs[i], 1e-12) << "n=" << n << " row " << i;
+            }
+        }
+    }
+
+    // A workspace left over from a larger fit must give the same spline as a fresh one, and
+    // refitting at the larger size again must reuse its storage.
+    TEST(SplineTest, WorkspaceReuse) {
+        vector<double> large_x = {0, 10, 20, 30, 40, 50, 60, 70}, large_y = {0, 5, 3, 8, 8, 2, -4, 1};
+        vector<double> small_x = {-3, -1, 0, 2}, small_y = {2, 0, 1, -1};
+        tk::spline_workspace ws;
+        tk::spline reused;
+        reused.set_points(large_x, large_y, true, ws);
+        const double *storage = ws.diag.data();
+        reused.set_points(small_x, small_y, true, ws);
+        tk::spline fresh;
+        fresh.set_points(small_x, small_y);
+        for(double x = -5; x <= 4; x += 0.25) {
+            EXPECT_EQ(reused(x), fresh(x)) << "x=" << x;
+            EXPECT_EQ(reused.deriv(1, x), fresh.deriv(1, x)) << "x=" << x;
+        }
+        reused.set_points(large_x, large_y, true, ws);
+        EXPECT_EQ(ws.diag.data(), storage);
+        tk::spline large;
+        large.set_points(large_x, large_y);
+        for(double x = -5; x <= 75; x += 2.5) {
+            EXPECT_EQ(reused(x), large(x)) << "x=" << x;
+        }
+    }
+
+    // Every channel of a multispline must match a tk::spline fitted to that channel alone.
+    // 5 channels covers both the 4-wide kernel and the channels left over after it.
+    TEST(SplineTest, Multispline) {
+        vector<double> x = {0, 10, 20, 30, 40, 50, 60, 70};
+        vector<vector<double>> y = {{0, 5, 3, 8, 8, 2, -4, 1}, {1, 1, 1, 1, 1, 1, 1, 1}, {0, 10, 20, 30, 40, 50, 60, 70},
+                                    {3, -2, 5, 0, 1, 9, 4, 4}, {-1, 0, 2, 1, 7, 3, 3, 6}};
+        tk::spline_workspace ws;
+        vector<double> short_x = {0, 1, 2};
+        tk::multispline<5> reused;
+        reused.set_points(short_x, vector<vector<double>>(5, vector<double>{0, 1, 0}), ws);
+        reused.set_points(x, y, ws);
+        vector<tk::spline> channels(5);
+        for(int j = 0; j < 5; j++) {
+            channels[j].set_points(x, y[j]);
+        }
+        tk::spline_cursor cursor;
+        for(double s = -10; s <= 80; s += 1.25) {
+            double values[5], cursor_values[5], derivs[5];
+            reused(s, values);
+            reused(s, cursor_values, cursor);
+            reused.deriv(s, derivs);
+            for(int j = 0; j < 5; j++) {
+                EXPECT_NEAR(values[j], channels[j](s), 1e-9) << "s=" << s << " channel " << j;
+                EXPECT_EQ(cursor_values[j], values[j]) << "s=" << s << " channel " << j;
+                EXPECT_NEAR(derivs[j], channels[j].deriv(1, s), 1e-9) << "s=" << s << " channel " << j;
+            }
+        }
+    }
+}
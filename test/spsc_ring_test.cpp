@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+#include "../src/spsc_ring.h"
+
+namespace {
+
+    TEST(SpscRingTest, FullAndEmpty) {
+        SpscRing<int, 4> ring;
+        EXPECT_EQ(ring.front(), nullptr);
+        for(int i = 0; i < 4; i++) {
+            ASSERT_NE(ring.back(), nullptr);
+            *ring.back() = i;
+            ring.push();
+        }
+        EXPECT_EQ(ring.back(), nullptr);
+        EXPECT_EQ(ring.size(), 4);
+        EXPECT_EQ(*ring.front(), 0);
+        ring.pop();
+        ASSERT_NE(ring.back(), nullptr);
+        *ring.back() = 4;
+        ring.push();
+        for(int i = 1; i <= 4; i++) {
+            ASSERT_NE(ring.front(), nullptr);
+            EXPECT_EQ(*ring.front(), i);
+            ring.pop();
+        }
+        EXPECT_EQ(ring.front(), nullptr);
+        EXPECT_EQ(ring.size(), 0);
+    }
+
+    // Slots are handed back as they were left, so their buffers can be reused.
+    TEST(SpscRingTest, ReusesSlots) {
+        SpscRing<vector<int>, 2> ring;
+        ring.back()->assign(100, 1);
+        const int *buffer = ring.back()->data();
+        ring.push();
+        ring.pop();
+        ring.back()->clear();
+        ring.push();
+        ring.pop();
+        EXPECT_EQ(ring.back()->data(), buffer);
+    }
+
+    TEST(SpscRingTest, Threads) {
+        SpscRing<int, 8> ring;
+        const int count = 200000;
+        thread producer([&ring] {
+            for(int i = 0; i < count; i++) {
+                int *slot;
+                while((slot = ring.back()) == nullptr) {
+                    this_thread::yield();
+                }
+                *slot = i;
+                ring.push();
+            }
+        });
+        for(int i = 0; i < count; i++) {
+            int *slot;
+            while((slot = ring.front()) == nullptr) {
+                this_thread::yield();
+            }
+            ASSERT_EQ(*slot, i);
+            ring.pop();
+        }
+        producer.join();
+    }
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include <string>
+#include "../src/json.hpp"
+#include "../src/telemetry.h"
+
+namespace {
+
+    const string message =
+            "42[\"telemetry\",{\"x\":909.48,\"y\":1128.67,\"yaw\":0,\"speed\":0,\"s\":124.8336,\"d\":6.164833,"
+            "\"previous_path_x\":[909.5,909.52,909.56],\"previous_path_y\":[1128.67,1128.67,1128.672],"
+            "\"end_path_s\":124.9,\"end_path_d\":6.16,"
+            "\"sensor_fusion\":[[0,1021.654,1147.212,12.4,0.5,235.5,2.036],"
+            "[1,1044.81,1150.55,-1.5e-1,3,258.7,-1E+2],[11,775.8,1421.6,0,0,6716.6,-277.6]]}]";
+
+    // Values must match what the json library reads from the same message.
+    TEST(TelemetryTest, MatchesJson) {
+        Telemetry telemetry;
+        ASSERT_EQ(telemetry.parse(message.data(), message.size()), Telemetry::DATA);
+        nlohmann::json j = nlohmann::json::parse(message.substr(2))[1];
+        EXPECT_EQ(telemetry.car_x, j["x"].get<double>());
+        EXPECT_EQ(telemetry.car_y, j["y"].get<double>());
+        EXPECT_EQ(telemetry.car_s, j["s"].get<double>());
+        EXPECT_EQ(telemetry.car_d, j["d"].get<double>());
+        EXPECT_EQ(telemetry.car_yaw, j["yaw"].get<double>());
+        EXPECT_EQ(telemetry.car_speed, j["speed"].get<double>());
+        EXPECT_EQ(telemetry.end_path_s, j["end_path_s"].get<double>());
+        EXPECT_EQ(telemetry.end_path_d, j["end_path_d"].get<double>());
+        EXPECT_EQ(telemetry.previous_path_x, j["previous_path_x"].get<vector<double>>());
+        EXPECT_EQ(telemetry.previous_path_y, j["previous_path_y"].get<vector<double>>());
+        ASSERT_EQ(telemetry.sensor_id.size(), j["sensor_fusion"].size());
+        for(size_t i = 0; i < telemetry.sensor_id.size(); i++) {
+            vector<double> row = j["sensor_fusion"][i].get<vector<double>>();
+            EXPECT_EQ(telemetry.sensor_id[i], int(row[0]));
+            EXPECT_EQ(telemetry.sensor_x[i], row[1]);
+            EXPECT_EQ(telemetry.sensor_y[i], row[2]);
+            EXPECT_EQ(telemetry.sensor_vx[i], row[3]);
+            EXPECT_EQ(telemetry.sensor_vy[i], row[4]);
+            EXPECT_EQ(telemetry.sensor_s[i], row[5]);
+            EXPECT_EQ(telemetry.sensor_d[i], row[6]);
+        }
+    }
+
+    // Nothing past length may be read, even where the buffer continues a number.
+    TEST(TelemetryTest, Length) {
+        string buffer = "42[\"telemetry\",{\"x\":15}]";
+        Telemetry telemetry;
+        EXPECT_EQ(telemetry.parse(buffer.data(), buffer.find("5")), Telemetry::OTHER);
+        EXPECT_EQ(telemetry.parse(buffer.data(), buffer.size()), Telemetry::DATA);
+        EXPECT_EQ(telemetry.car_x, 15);
+    }
+
+    TEST(TelemetryTest, Events) {
+        Telemetry telemetry;
+        string manual = "42[\"telemetry\",null]";
+        EXPECT_EQ(telemetry.parse(manual.data(), manual.size()), Telemetry::NO_DATA);
+        string other = "42[\"manual\",{}]";
+        EXPECT_EQ(telemetry.parse(other.data(), other.size()), Telemetry::OTHER);
+        string ping = "2";
+        EXPECT_EQ(telemetry.parse(ping.data(), ping.size()), Telemetry::OTHER);
+        string truncated = message.substr(0, message.size() / 2);
+        EXPECT_EQ(telemetry.parse(truncated.data(), truncated.size()), Telemetry::OTHER);
+        string unknown = "42[\"telemetry\",{\"extra\":{\"a\":[1,\"]\"]},\"x\":3}]";
+        ASSERT_EQ(telemetry.parse(unknown.data(), unknown.size()), Telemetry::DATA);
+        EXPECT_EQ(telemetry.car_x, 3);
+    }
+
+    // Parsing the same message twice must reuse the arrays from the first time.
+    TEST(TelemetryTest, ReusesBuffers) {
+        Telemetry telemetry;
+        ASSERT_EQ(telemetry.parse(message.data(), message.size()), Telemetry::DATA);
+        const double *path_x = telemetry.previous_path_x.data();
+        const double *sensor_x = telemetry.sensor_x.data();
+        ASSERT_EQ(telemetry.parse(message.data(), message.size()), Telemetry::DATA);
+        EXPECT_EQ(telemetry.previous_path_x.data(), path_x);
+        EXPECT_EQ(telemetry.sensor_x.data(), sensor_x);
+        EXPECT_EQ(telemetry.previous_path_x.size(), 3);
+        EXPECT_EQ(telemetry.sensor_x.size(), 3);
+    }
+}
@@ -0,0 +1,96 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "../src/thread_pool.h"
+
+namespace {
+
+    // Blocks the calling test until count tasks have called done().
+    class Latch {
+    private:
+        mutex _mutex;
+        condition_variable _done;
+        int _count;
+    public:
+        explicit Latch(int count) : _count(count) {}
+        void done() {
+            lock_guard<mutex> lock(_mutex);
+            if(--_count == 0) {
+                _done.notify_all();
+            }
+        }
+        void wait() {
+            unique_lock<mutex> lock(_mutex);
+            _done.wait(lock, [this] { return _count == 0; });
+        }
+    };
+
+    TEST(ThreadPoolTest, RunsEveryTask) {
+        ThreadPool pool(3);
+        EXPECT_EQ(pool.size(), 3);
+        atomic<int> sum(0);
+        Latch latch(1000);
+        for(int i = 0; i < 1000; i++) {
+            pool.submit([i, &sum, &latch] {
+                sum += i;
+                latch.done();
+            });
+        }
+        latch.wait();
+        EXPECT_EQ(sum, 999 * 1000 / 2);
+    }
+
+    // Tasks submitted by a task stay on its worker's queue, where idle workers must steal them.
+    TEST(ThreadPoolTest, Steals) {
+        ThreadPool pool(4);
+        mutex m;
+        vector<thread::id> ids;
+        Latch latch(8);
+        pool.submit([&] {
+            for(int i = 0; i < 8; i++) {
+                pool.submit([&] {
+                    this_thread::sleep_for(chrono::milliseconds(20));
+                    {
+                        lock_guard<mutex> lock(m);
+                        ids.push_back(this_thread::get_id());
+                    }
+                    latch.done();
+                });
+            }
+        });
+        latch.wait();
+        sort(ids.begin(), ids.end());
+        EXPECT_GT(unique(ids.begin(), ids.end()) - ids.begin(), 1);
+    }
+
+    // Tasks dealt to a worker that is stuck on a long task must be stolen by the other one.
+    TEST(ThreadPoolTest, StealsFromBusyWorker) {
+        ThreadPool pool(2);
+        mutex m;
+        condition_variable released;
+        bool release = false;
+        Latch blocked(1), latch(6);
+        pool.submit([&] {
+            blocked.done();
+            unique_lock<mutex> lock(m);
+            released.wait(lock, [&] { return release; });
+        });
+        blocked.wait();
+        for(int i = 0; i < 6; i++) {
+            pool.submit([&] { latch.done(); });
+        }
+        latch.wait();
+        {
+            lock_guard<mutex> lock(m);
+            release = true;
+        }
+        released.notify_all();
+    }
+
+    TEST(ThreadPoolTest, NoThreads) {
+        EXPECT_ANY_THROW(ThreadPool(0));
+    }
+}
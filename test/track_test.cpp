@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include "../src/frenet_tracker.h"
+#include "../src/track.h"
+
+namespace {
+
+    // Tests are run from the build directory, like the path_planning executable.
+    const string map_file = "../data/highway_map.csv";
+
+    TEST(TrackTest, RoundTrip) {
+        Track track(map_file);
+        for(double s = 0; s < 6900; s += 37.5) {
+            for(double d : {2.0, 6.0, 10.0}) {
+                vector<double> xy = track.sd_to_xy(s, d);
+                vector<double> sd = track.xy_to_sd(xy[0], xy[1]);
+                EXPECT_NEAR(sd[0], s, 0.05) << "s=" << s << " d=" << d;
+                EXPECT_NEAR(sd[1], d, 0.05) << "s=" << s << " d=" << d;
+            }
+        }
+    }
+
+    TEST(TrackTest, BatchVelocity) {
+        Track track(map_file);
+        vector<double> x, y, vx, vy, expected_s, expected_d;
+        for(double s = 100; s < 6800; s += 500) {
+            for(double d : {2.0, 6.0, 10.0}) {
+                vector<double> xyv = track.sd_to_xyv(s, d, 20.0, 0.0);
+                x.push_back(xyv[0]);
+                y.push_back(xyv[1]);
+                vx.push_back(xyv[2]);
+                vy.push_back(xyv[3]);
+                expected_s.push_back(s);
+                expected_d.push_back(d);
+            }
+        }
+        size_t n = x.size();
+        vector<double> s(n), d(n), vs(n), vd(n);
+        track.xyv_to_sdv(n, x.data(), y.data(), vx.data(), vy.data(), s.data(), d.data(), vs.data(), vd.data());
+        for(size_t i = 0; i < n; i++) {
+            EXPECT_NEAR(s[i], expected_s[i], 0.05);
+            EXPECT_NEAR(d[i], expected_d[i], 0.05);
+            EXPECT_NEAR(vs[i], 20.0, 0.1);
+            EXPECT_NEAR(vd[i], 0.0, 0.1);
+        }
+    }
+
+    TEST(TrackTest, WarmStart) {
+        Track track(map_file);
+        for(double s = 100; s < 6800; s += 250) {
+            vector<double> xy = track.sd_to_xy(s, 6.0);
+            // Near hint converges from the hint, far hint has to fall back to the global search.
+            for(double hint : {s - 1.5, s + 0.5, s + 3000}) {
+                vector<double> sd = track.xy_to_sd(xy[0], xy[1], hint);
+                EXPECT_NEAR(sd[0], s, 0.05) << "s=" << s << " hint=" << hint;
+                EXPECT_NEAR(sd[1], 6.0, 0.05) << "s=" << s << " hint=" << hint;
+            }
+        }
+    }
+
+    // Estimates for ids that stop appearing must be dropped, while ids still seen keep theirs.
+    TEST(TrackTest, TrackerForgetsMissingIds) {
+        Track track(map_file);
+        FrenetTracker tracker;
+        vector<double> xy = track.sd_to_xy(500, 6.0);
+        int ids[] = {7, 8};
+        double vx[] = {0, 0}, vy[] = {0, 0}, x[] = {xy[0], xy[0]}, y[] = {xy[1], xy[1]};
+        double s[2], d[2], vs[2], vd[2];
+        tracker.xyv_to_sdv(track, 2, ids, x, y, vx, vy, s, d, vs, vd);
+        EXPECT_NEAR(tracker.hint(8), 500, 0.05);
+        for(unsigned long i = 0; i < FrenetTracker::MAX_MISSED_CALLS; i++) {
+            tracker.xyv_to_sdv(track, 1, ids, x, y, vx, vy, s, d, vs, vd);
+        }
+        EXPECT_NEAR(tracker.hint(8), 500, 0.05);
+        tracker.xyv_to_sdv(track, 1, ids, x, y, vx, vy, s, d, vs, vd);
+        EXPECT_TRUE(isnan(tracker.hint(8)));
+        EXPECT_NEAR(tracker.hint(7), 500, 0.05);
+    }
+
+    TEST(TrackTest, Baked) {
+        Track track(map_file);
+        Track baked(track);
+        baked.bake(0.5);
+        for(double s = -50; s < 7000; s += 3.7) {
+            vector<double> xy = track.sd_to_xy(s, 6.0);
+            vector<double> baked_xy = baked.sd_to_xy(s, 6.0);
+            EXPECT_NEAR(baked_xy[0], xy[0], 0.001) << "s=" << s;
+            EXPECT_NEAR(baked_xy[1], xy[1], 0.001) << "s=" << s;
+        }
+    }
+
+    TEST(TrackTest, BatchPath) {
+        Track track(map_file);
+        vector<double> s, d;
+        for(double path_s = 6800; path_s < 7100; path_s += 0.4) {
+            s.push_back(path_s);
+            d.push_back(2.0 + path_s / 100);
+        }
+        vector<double> x(s.size()), y(s.size());
+        track.sd_to_xy(s.size(), s.data(), d.data(), x.data(), y.data());
+        for(size_t i = 0; i < s.size(); i++) {
+            vector<double> xy = track.sd_to_xy(s[i], d[i]);
+            EXPECT_DOUBLE_EQ(x[i], xy[0]);
+            EXPECT_DOUBLE_EQ(y[i], xy[1]);
+        }
+    }
+
+    TEST(TrackTest, Compiled) {
+        Track track(map_file);
+        track.bake(0.5);
+        string compiled_file = "track_test_compiled.trk";
+        track.save_compiled(compiled_file);
+        Track compiled(compiled_file);
+        remove(compiled_file.c_str());
+        for(double s = -50; s < 7000; s += 13.1) {
+            EXPECT_EQ(compiled.sd_to_xy(s, 6.0), track.sd_to_xy(s, 6.0));
+            vector<double> xy = track.sd_to_xy(s, 2.0);
+            EXPECT_EQ(compiled.xy_to_sd(xy[0], xy[1]), track.xy_to_sd(xy[0], xy[1]));
+        }
+    }
+
+    // A corrupt or truncated compiled track must be rejected rather than read out of bounds.
+    TEST(TrackTest, CompiledCorrupt) {
+        Track track(map_file);
+        string compiled_file = "track_test_corrupt.trk";
+        track.save_compiled(compiled_file);
+        // Without a baked table the file ends with the index's sample list.
+        FILE *file = fopen(compiled_file.c_str(), "r+b");
+        ASSERT_NE(file, nullptr);
+        int32_t sample = 1 << 30;
+        fseek(file, -long(sizeof(sample)), SEEK_END);
+        fwrite(&sample, sizeof(sample), 1, file);
+        fclose(file);
+        EXPECT_THROW(Track corrupt(compiled_file), runtime_error);
+        ASSERT_EQ(truncate(compiled_file.c_str(), 100), 0);
+        EXPECT_THROW(Track truncated(compiled_file), runtime_error);
+        remove(compiled_file.c_str());
+    }
+
+    TEST(TrackTest, SharedAcrossThreads) {
+        shared_ptr<Track> loaded_track = make_shared<Track>(map_file);
+        loaded_track->bake(0.5);
+        shared_ptr<const Track> track = loaded_track;
+        vector<double> expected_s;
+        for(double s = 0; s < 6900; s += 7.3) {
+            expected_s.push_back(s);
+        }
+        int num_threads = 4;
+        vector<vector<double>> results(num_threads);
+        vector<thread> threads;
+        for(int i = 0; i < num_threads; i++) {
+            threads.push_back(thread([&track, &expected_s, &results, i]() {
+                for(double s : expected_s) {
+                    vector<double> xy = track->sd_to_xy(s, 6.0);
+                    results[i].push_back(track->xy_to_sd(xy[0], xy[1])[0]);
+                }
+            }));
+        }
+        for(thread &t : threads) {
+            t.join();
+        }
+        for(int i = 0; i < num_threads; i++) {
+            ASSERT_EQ(results[i].size(), expected_s.size());
+            for(size_t k = 0; k < expected_s.size(); k++) {
+                EXPECT_NEAR(results[i][k], expected_s[k], 0.05);
+            }
+        }
+    }
+}
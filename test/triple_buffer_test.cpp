@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+#include "../src/triple_buffer.h"
+
+namespace {
+
+    TEST(TripleBufferTest, KeepsNewest) {
+        TripleBuffer<int> buffer;
+        EXPECT_FALSE(buffer.fresh());
+        EXPECT_EQ(buffer.take(), nullptr);
+        for(int i = 0; i < 3; i++) {
+            buffer.back() = i;
+            buffer.publish();
+        }
+        EXPECT_TRUE(buffer.fresh());
+        int *value = buffer.take();
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, 2);
+        EXPECT_FALSE(buffer.fresh());
+        EXPECT_EQ(buffer.take(), nullptr);
+        buffer.back() = 3;
+        buffer.publish();
+        value = buffer.take();
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(*value, 3);
+    }
+
+    // Slots are handed back as they were left, so their buffers can be reused.
+    TEST(TripleBufferTest, ReusesSlots) {
+        TripleBuffer<vector<int>> buffer;
+        for(int i = 0; i < 3; i++) {
+            buffer.back().assign(100, i);
+            buffer.publish();
+            buffer.take();
+        }
+        for(int i = 0; i < 6; i++) {
+            EXPECT_GE(buffer.back().capacity(), 100);
+            buffer.back().clear();
+            buffer.publish();
+            EXPECT_GE(buffer.take()->capacity(), 100);
+        }
+    }
+
+    // The consumer sees values in order, possibly skipping some, and always ends on the last one.
+    TEST(TripleBufferTest, Threads) {
+        TripleBuffer<vector<int>> buffer;
+        const int count = 200000;
+        thread producer([&buffer] {
+            for(int i = 1; i <= count; i++) {
+                buffer.back().assign(4, i);
+                buffer.publish();
+            }
+        });
+        int last = 0;
+        while(last < count) {
+            vector<int> *value = buffer.take();
+            if(value == nullptr) {
+                this_thread::yield();
+                continue;
+            }
+            ASSERT_EQ(*value, vector<int>(4, (*value)[0]));
+            ASSERT_GT((*value)[0], last);
+            last = (*value)[0];
+        }
+        producer.join();
+    }
+}